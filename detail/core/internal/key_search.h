@@ -0,0 +1,153 @@
+#ifndef LIB_KEY_SEARCH_H
+#define LIB_KEY_SEARCH_H
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LIB_KEY_SEARCH_X86 1
+#include <immintrin.h>
+#endif
+
+namespace core::internal {
+
+/**
+ * @brief Integer key types CountLess has a vectorized path for.
+ */
+template<typename K>
+concept SimdSearchableKey = std::integral<K> && !std::same_as<K, bool> && (sizeof(K) == 4 || sizeof(K) == 8);
+
+/**
+ * @brief Integer types std::cmp_less accepts: every integral type but bool
+ * and the character types.
+ */
+template<typename T>
+concept StandardInteger = std::integral<T> && !std::same_as<T, bool> && !std::same_as<T, char> &&
+                          !std::same_as<T, wchar_t> && !std::same_as<T, char8_t> && !std::same_as<T, char16_t> &&
+                          !std::same_as<T, char32_t>;
+
+/**
+ * @brief Counts the keys in [i, count) less than key with a scalar loop the
+ * compiler can vectorize for the build's baseline target.
+ */
+template<SimdSearchableKey K>
+inline uint32_t CountLessScalar(const K* keys, uint32_t count, K key, uint32_t i = 0) {
+    uint32_t less = 0;
+    for (; i < count; ++i) {
+        less += static_cast<uint32_t>(keys[i] < key);
+    }
+    return less;
+}
+
+#ifdef LIB_KEY_SEARCH_X86
+// Signed compares only; unsigned keys are biased into signed order
+template<SimdSearchableKey K>
+constexpr K SignBias = std::is_unsigned_v<K> ? K{1} << ((sizeof(K) * 8) - 1) : K{0};
+
+/**
+ * @brief Counts the keys in [i, count) less than key two or four at a time
+ * with SSE4.2 compares, then the rest with the scalar loop.
+ */
+template<SimdSearchableKey K>
+__attribute__((target("sse4.2"))) uint32_t CountLessSse42(const K* keys, uint32_t count, K key, uint32_t i = 0) {
+    constexpr K Bias = SignBias<K>;
+    uint32_t less = 0;
+    if constexpr (sizeof(K) == 4) {
+        __m128i target = _mm_set1_epi32(static_cast<int32_t>(key ^ Bias));
+        __m128i bias = _mm_set1_epi32(static_cast<int32_t>(Bias));
+        for (; i + 4 <= count; i += 4) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+            __m128i gt = _mm_cmpgt_epi32(target, _mm_xor_si128(block, bias));
+            less += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(gt)));
+        }
+    } else {
+        __m128i target = _mm_set1_epi64x(static_cast<int64_t>(key ^ Bias));
+        __m128i bias = _mm_set1_epi64x(static_cast<int64_t>(Bias));
+        for (; i + 2 <= count; i += 2) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+            __m128i gt = _mm_cmpgt_epi64(target, _mm_xor_si128(block, bias));
+            less += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(gt)));
+        }
+    }
+    return less + CountLessScalar(keys, count, key, i);
+}
+
+/**
+ * @brief Counts the keys in [i, count) less than key four or eight at a time
+ * with AVX2 compares, then the rest with SSE4.2 and the scalar loop.
+ */
+template<SimdSearchableKey K>
+__attribute__((target("avx2"))) uint32_t CountLessAvx2(const K* keys, uint32_t count, K key, uint32_t i = 0) {
+    constexpr K Bias = SignBias<K>;
+    uint32_t less = 0;
+    if constexpr (sizeof(K) == 4) {
+        __m256i target = _mm256_set1_epi32(static_cast<int32_t>(key ^ Bias));
+        __m256i bias = _mm256_set1_epi32(static_cast<int32_t>(Bias));
+        for (; i + 8 <= count; i += 8) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+            __m256i gt = _mm256_cmpgt_epi32(target, _mm256_xor_si256(block, bias));
+            less += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(gt)));
+        }
+    } else {
+        __m256i target = _mm256_set1_epi64x(static_cast<int64_t>(key ^ Bias));
+        __m256i bias = _mm256_set1_epi64x(static_cast<int64_t>(Bias));
+        for (; i + 4 <= count; i += 4) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+            __m256i gt = _mm256_cmpgt_epi64(target, _mm256_xor_si256(block, bias));
+            less += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(gt)));
+        }
+    }
+    return less + CountLessSse42(keys, count, key, i);
+}
+
+/**
+ * @brief Vector extensions CountLess may use on this CPU, probed once.
+ */
+struct KeySearchCpu {
+    bool avx2;
+    bool sse42;
+};
+
+inline const KeySearchCpu& DetectKeySearchCpu() {
+    static const KeySearchCpu cpu = [] {
+        __builtin_cpu_init();
+        return KeySearchCpu{
+            .avx2 = __builtin_cpu_supports("avx2") != 0,
+            .sse42 = __builtin_cpu_supports("sse4.2") != 0,
+        };
+    }();
+    return cpu;
+}
+#endif
+
+/**
+ * @brief Counts the keys less than key, branch-free. On sorted keys this is
+ * the lower bound position. On x86 whole vectors of keys are processed with
+ * compare-and-movemask, using AVX2 or else SSE4.2 as the CPU supports at
+ * runtime, so no target flags are needed at build time; the rest, and other
+ * targets, use a scalar loop the compiler can vectorize.
+ *
+ * @param keys Keys to search
+ * @param count Number of keys
+ * @param key Key to compare against
+ * @return uint32_t Number of keys less than key
+ */
+template<SimdSearchableKey K>
+inline uint32_t CountLess(const K* keys, uint32_t count, K key) {
+#ifdef LIB_KEY_SEARCH_X86
+    const KeySearchCpu& cpu = DetectKeySearchCpu();
+    if (cpu.avx2) {
+        return CountLessAvx2(keys, count, key);
+    }
+    if (cpu.sse42) {
+        return CountLessSse42(keys, count, key);
+    }
+#endif
+    return CountLessScalar(keys, count, key);
+}
+
+}  // namespace core::internal
+
+#endif
@@ -0,0 +1,227 @@
+#ifndef CORE_BUFFERED_ORDERED_MAP_FILE_H
+#define CORE_BUFFERED_ORDERED_MAP_FILE_H
+
+#include "core/map.h"
+#include "core/optional.h"
+#include "core/ordered_map_file.h"
+#include "core/vector_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace core {
+
+/**
+ * @brief BufferedOrderedMapFile is an OrderedMapFile fronted by an in-memory
+ * sorted write buffer, in the manner of an LSM tree. Writes go to the buffer
+ * and to a small append-only log, and once the buffer holds bufferCapacity
+ * keys, or the log twice that many records, it is merged into the tree in key
+ * order. Consecutive keys of a merge
+ * mostly land in the same leaf, so random-key writes reach the tree's pages
+ * as a sequential sweep rather than one random leaf write each. Lookups
+ * consult the buffer first and then the tree.
+ *
+ * The log lives in a sibling file at path + ".log" and is replayed into the
+ * buffer on open, so buffered writes survive a crash to the same degree as
+ * writes to the tree: under Durability::Explicit they are durable once
+ * Commit() returns, and under Durability::Periodic once the log commits. In
+ * either mode a merge syncs the tree before emptying the log. Every log
+ * record sets or erases a key outright, so replaying a log whose merge was
+ * interrupted is harmless. Bounding the log, not just the buffer, keeps
+ * rewrites of a few hot keys from growing it, and replay time, without end.
+ *
+ * @tparam K Key type
+ * @tparam V Value type
+ * @tparam N Maximum number of entries per tree node
+ * @tparam Compare Comparator
+ */
+template<typename K, typename V, size_t N, TotalOrderComparator<K, K> Compare>
+    requires std::is_trivially_copyable_v<K> && std::is_trivially_copyable_v<V>
+class BufferedOrderedMapFile {
+    using Tree = OrderedMapFile<K, V, N, Compare>;
+
+    struct Entry {
+        V value;
+        uint32_t erased;
+    };
+
+    struct LogRecord {
+        K key;
+        V value;
+        uint32_t erased;
+    };
+
+    /**
+     * @brief Adapts the three-way comparator to the less-than the buffer
+     * expects.
+     */
+    struct BufferLess {
+        Compare compare;
+
+        bool operator()(const K& a, const K& b) const { return compare(a, b) < 0; }
+    };
+
+public:
+    static constexpr size_t DefaultBufferCapacity = 65536;
+
+    /**
+     * @brief Creates or opens a BufferedOrderedMapFile at the given path,
+     * replaying any writes left in its log.
+     *
+     * @param path Path of backing file for the tree
+     * @param compare Comparator to use for maintaining ordering
+     * @param bufferCapacity Number of buffered keys that triggers a merge
+     * @param options Options for the tree's node file. The log shares its
+     * durability policy.
+     */
+    BufferedOrderedMapFile(const char* path,
+                           Compare compare,
+                           size_t bufferCapacity = DefaultBufferCapacity,
+                           VectorFileOptions options = {})
+        : tree_(path, compare, options),
+          log_((std::string{path} + ".log").c_str(),
+               VectorFileOptions{.durability = options.durability, .commitInterval = options.commitInterval}),
+          buffer_(BufferLess{compare}),
+          capacity_(bufferCapacity),
+          durability_(options.durability) {
+        if (capacity_ == 0) {
+            throw std::invalid_argument("buffer capacity must be non-zero");
+        }
+        for (const LogRecord& record : log_) {
+            Apply(record.key, Entry{.value = record.value, .erased = record.erased});
+        }
+        if (MergeDue()) {
+            Flush();
+        }
+    }
+
+    /**
+     * @brief Number of keys with writes waiting in the buffer.
+     */
+    size_t Buffered() const { return buffer_.size(); }
+
+    /**
+     * @brief The underlying tree, holding every write as of the last merge.
+     */
+    const Tree& Merged() const { return tree_; }
+
+    /**
+     * @brief Attempts to insert a key-value pair into the map. Checking for
+     * the key reads the buffer and then, if the key is not buffered, the
+     * tree.
+     *
+     * @param key Key to insert
+     * @param val Value to insert
+     * @return true Insertion occurred
+     * @return false Insertion did not occur -- key already present
+     */
+    bool Insert(K key, V val) {
+        if (Contains(key)) {
+            return false;
+        }
+        Write(key, Entry{.value = val, .erased = 0});
+        return true;
+    }
+
+    /**
+     * @brief Inserts a key-value pair, or assigns the value if the key is
+     * already present. Does not touch the tree until the next merge.
+     *
+     * @param key Key to insert
+     * @param val Value to insert or assign
+     */
+    void InsertOrAssign(K key, V val) { Write(key, Entry{.value = val, .erased = 0}); }
+
+    /**
+     * @brief Removes a key from the map, if present. Does not touch the tree
+     * until the next merge.
+     *
+     * @param key Key to remove
+     */
+    void Erase(K key) { Write(key, Entry{.value = V{}, .erased = 1}); }
+
+    /**
+     * @brief Finds the value of a key, in the buffer or else the tree.
+     *
+     * @param key Key to look up
+     * @return Copy of the value, if key is in map.
+     */
+    core::Optional<V> Find(const K& key) const {
+        auto it = buffer_.find(key);
+        if (it != buffer_.end()) {
+            if (it->second.erased != 0) {
+                return core::nullopt;
+            }
+            return core::Optional<V>{it->second.value};
+        }
+        if (auto found = tree_.Find(key)) {
+            return core::Optional<V>{*found->value};
+        }
+        return core::nullopt;
+    }
+
+    bool Contains(const K& key) const {
+        auto it = buffer_.find(key);
+        if (it != buffer_.end()) {
+            return it->second.erased == 0;
+        }
+        return tree_.Contains(key);
+    }
+
+    /**
+     * @brief Merges the buffer into the tree in key order and empties the
+     * log. Under a durable policy the tree is synced first, so the log is
+     * never emptied ahead of the writes it holds reaching disk.
+     */
+    void Flush() {
+        for (const auto& [key, entry] : buffer_) {
+            if (entry.erased != 0) {
+                tree_.Erase(key);
+            } else {
+                tree_.InsertOrAssign(key, entry.value);
+            }
+        }
+        if (durability_ != Durability::None) {
+            tree_.Sync();
+        }
+        buffer_.clear();
+        log_.Clear();
+    }
+
+    /**
+     * @brief Makes every write so far durable by committing the log, without
+     * merging the buffer.
+     */
+    void Commit() { log_.Commit(); }
+
+private:
+    void Write(const K& key, const Entry& entry) {
+        log_.PushBack(LogRecord{.key = key, .value = entry.value, .erased = entry.erased});
+        Apply(key, entry);
+        if (MergeDue()) {
+            Flush();
+        }
+    }
+
+    bool MergeDue() const { return buffer_.size() >= capacity_ || log_.Size() >= 2 * capacity_; }
+
+    void Apply(const K& key, const Entry& entry) {
+        auto [it, inserted] = buffer_.insert(key, entry);
+        if (!inserted) {
+            it->second = entry;
+        }
+    }
+
+    Tree tree_;
+    VectorFile<LogRecord> log_;
+    core::Map<K, Entry, BufferLess> buffer_;
+    size_t capacity_;
+    Durability durability_;
+};
+
+}  // namespace core
+
+#endif
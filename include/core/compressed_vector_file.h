@@ -0,0 +1,348 @@
+#ifndef CORE_COMPRESSED_VECTOR_FILE_H
+#define CORE_COMPRESSED_VECTOR_FILE_H
+
+#include "core/array.h"
+#include "core/span.h"
+#include "core/vector_file.h"
+
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace core {
+
+/**
+ * @brief CompressedVectorFile is an append-only vector of unsigned integers
+ * backed by memory-mapped files, stored in fixed-size bit-packed blocks.
+ *
+ * Each full block of BlockSize values is encoded on its own. Non-decreasing
+ * blocks (posting lists, doc-id arrays) store the gaps between consecutive
+ * values, and other blocks store each value's offset from the block minimum.
+ * Either way every entry uses the bit width of the largest one. A block index
+ * gives O(1) seek to any block, and iteration decodes a block at a time.
+ * Random access decodes within one block: O(1) in an offset block, but a
+ * delta block sums the gaps from its start, so O(pos) within the block. The
+ * trailing partial block is kept uncompressed in the file header until it
+ * fills.
+ *
+ * The packed words live in the file at path, and the block index in a
+ * sibling file at path + ".blocks". The two grow separately, so after a
+ * crash either may hold a block past the recorded size; opening a writable
+ * file trims them back, and opening throws if either is missing a block.
+ *
+ * @tparam T Element type
+ */
+template<typename T>
+    requires std::same_as<T, uint32_t> || std::same_as<T, uint64_t>
+class CompressedVectorFile {
+public:
+    static constexpr size_t BlockSize = 128;
+
+private:
+    static constexpr size_t WordBits = 64;
+
+    // Packed entries of one block fill exactly BlockSize * width / 64 words
+    static_assert(BlockSize % WordBits == 0);
+
+    struct Metadata {
+        uint64_t size;
+        core::Array<T, BlockSize> tail;  // Values of trailing partial block
+    };
+
+    struct BlockEntry {
+        uint64_t wordOffset;  // Offset of block's first word in packed words
+        uint64_t base;        // First value (delta) or minimum (offset)
+        uint32_t bitWidth;    // Bits per packed entry
+        uint32_t isDelta;     // Whether entries are gaps between values
+    };
+
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = T;
+
+        Iterator() = default;
+
+        T operator*() const { return block_[index_ % BlockSize]; }
+
+        Iterator& operator++() {
+            ++index_;
+            if (index_ % BlockSize == 0 && index_ < file_->Size()) {
+                Load();
+            }
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const Iterator& other) const { return index_ == other.index_; }
+
+    private:
+        friend class CompressedVectorFile;
+
+        Iterator(const CompressedVectorFile* file, size_t index) : file_(file), index_(index) {
+            if (index_ < file_->Size()) {
+                Load();
+            }
+        }
+
+        void Load() { file_->DecodeBlock(index_ / BlockSize, block_.Data()); }
+
+        const CompressedVectorFile* file_{nullptr};
+        size_t index_{0};
+        core::Array<T, BlockSize> block_;
+    };
+
+    /**
+     * @brief Creates or opens a CompressedVectorFile at the given path.
+     *
+     * @param path Path of backing file for packed words
+     * @param options Options applied to both backing files. The layout
+     * version is set by the file, so files with another block encoding are
+     * refused.
+     */
+    CompressedVectorFile(const char* path, VectorFileOptions options = {})
+        : words_(path, LayoutOptions(options)),
+          blocks_((std::string{path} + ".blocks").c_str(), LayoutOptions(options)) {
+        Reconcile();
+    }
+
+    bool ReadOnly() const { return words_.ReadOnly(); }
+
+    size_t Size() const { return words_.CustomData()->size; }
+    bool Empty() const { return Size() == 0; }
+
+    /**
+     * @brief Number of bytes used by packed words and the block index.
+     */
+    size_t CompressedBytes() const { return (words_.Size() * sizeof(uint64_t)) + (blocks_.Size() * sizeof(BlockEntry)); }
+
+    /**
+     * @brief Gets the value at an index, decoding within at most one block.
+     *
+     * @param n Index of value
+     * @return T Value
+     */
+    T operator[](size_t n) const {
+        if (n >= Size()) {
+            throw std::out_of_range("index out of range");
+        }
+
+        size_t block = n / BlockSize;
+        size_t pos = n % BlockSize;
+        if (block == blocks_.Size()) {
+            return words_.CustomData()->tail[pos];
+        }
+
+        const BlockEntry& entry = blocks_[block];
+        const uint64_t* words = words_.Data() + entry.wordOffset;
+        if (!entry.isDelta) {
+            return static_cast<T>(entry.base + Unpack(words, pos, entry.bitWidth));
+        }
+        uint64_t value = entry.base;
+        for (size_t i = 1; i <= pos; ++i) {
+            value += Unpack(words, i, entry.bitWidth);
+        }
+        return static_cast<T>(value);
+    }
+
+    /**
+     * @brief Decodes all values of a block into out. The trailing partial
+     * block decodes only its present values.
+     *
+     * @param block Index of block
+     * @param out Destination for up to BlockSize values
+     */
+    void DecodeBlock(size_t block, T* out) const {
+        if (block == blocks_.Size()) {
+            const auto& tail = words_.CustomData()->tail;
+            size_t count = Size() - (block * BlockSize);
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = tail[i];
+            }
+            return;
+        }
+
+        const BlockEntry& entry = blocks_[block];
+        const uint64_t* words = words_.Data() + entry.wordOffset;
+        if (entry.isDelta) {
+            uint64_t value = entry.base;
+            out[0] = static_cast<T>(value);
+            for (size_t i = 1; i < BlockSize; ++i) {
+                value += Unpack(words, i, entry.bitWidth);
+                out[i] = static_cast<T>(value);
+            }
+        } else {
+            for (size_t i = 0; i < BlockSize; ++i) {
+                out[i] = static_cast<T>(entry.base + Unpack(words, i, entry.bitWidth));
+            }
+        }
+    }
+
+    Iterator begin() const { return Iterator{this, 0}; }
+    Iterator end() const { return Iterator{this, Size()}; }
+
+    /**
+     * @brief Pushes the value to the end of the vector.
+     *
+     * @param value Value to push
+     */
+    void PushBack(T value) {
+        CheckWritable();
+        Metadata* meta = words_.CustomData();
+        size_t pos = meta->size % BlockSize;
+        meta->tail[pos] = value;
+        if (pos == BlockSize - 1) {
+            FlushTail();
+            // Growing the packed words may have remapped the header
+            meta = words_.CustomData();
+        }
+        ++meta->size;
+    }
+
+    /**
+     * @brief Appends a range of values to the end of the vector.
+     *
+     * @param values Values to append
+     */
+    void Append(core::Span<const T> values) {
+        CheckWritable();
+        for (T value : values) {
+            PushBack(value);
+        }
+    }
+
+private:
+    // Version of the Metadata and BlockEntry layout and of the block
+    // encoding, recorded in both files. Bump it whenever any of them changes,
+    // so old files are refused at open.
+    static constexpr uint32_t LayoutVersion = 1;
+
+    static VectorFileOptions LayoutOptions(VectorFileOptions options) {
+        options.layoutVersion = LayoutVersion;
+        return options;
+    }
+
+    void CheckWritable() const {
+        if (ReadOnly()) {
+            throw std::runtime_error("compressed vector file is read-only");
+        }
+    }
+
+    /**
+     * @brief Number of packed words of a full block.
+     */
+    static size_t WordCount(const BlockEntry& entry) { return BlockSize * entry.bitWidth / WordBits; }
+
+    /**
+     * @brief Checks the packed words and block index against the recorded
+     * size, trimming blocks a crash left past it.
+     */
+    void Reconcile() {
+        size_t blocks = Size() / BlockSize;
+        if (blocks_.Size() < blocks) {
+            throw std::runtime_error("compressed vector file block index is truncated");
+        }
+        size_t words = 0;
+        if (blocks > 0) {
+            const BlockEntry& last = std::as_const(blocks_)[blocks - 1];
+            words = last.wordOffset + WordCount(last);
+        }
+        if (words_.Size() < words) {
+            throw std::runtime_error("compressed vector file words are truncated");
+        }
+
+        // A read-only file never reaches the extra blocks
+        if (!ReadOnly()) {
+            while (blocks_.Size() > blocks) {
+                blocks_.PopBack();
+            }
+            while (words_.Size() > words) {
+                words_.PopBack();
+            }
+        }
+    }
+
+    /**
+     * @brief Reads the i-th packed entry of the given width.
+     */
+    static uint64_t Unpack(const uint64_t* words, size_t i, uint32_t width) {
+        if (width == 0) {
+            return 0;
+        }
+        size_t bit = i * width;
+        size_t word = bit / WordBits;
+        size_t shift = bit % WordBits;
+        uint64_t value = words[word] >> shift;
+        if (shift + width > WordBits) {
+            value |= words[word + 1] << (WordBits - shift);
+        }
+        return width == WordBits ? value : value & ((uint64_t{1} << width) - 1);
+    }
+
+    /**
+     * @brief Encodes the now-full tail block and appends it to the packed
+     * words and block index.
+     */
+    void FlushTail() {
+        const auto& tail = words_.CustomData()->tail;
+
+        bool monotone = true;
+        T min = tail[0];
+        T max = tail[0];
+        uint64_t max_gap = 0;
+        for (size_t i = 1; i < BlockSize; ++i) {
+            monotone = monotone && tail[i] >= tail[i - 1];
+            if (monotone) {
+                max_gap = std::max<uint64_t>(max_gap, tail[i] - tail[i - 1]);
+            }
+            min = std::min(min, tail[i]);
+            max = std::max(max, tail[i]);
+        }
+
+        BlockEntry entry{
+            .wordOffset = words_.Size(),
+            .base = monotone ? tail[0] : min,
+            .bitWidth = static_cast<uint32_t>(std::bit_width(monotone ? max_gap : uint64_t{max} - min)),
+            .isDelta = monotone,
+        };
+
+        core::Array<uint64_t, BlockSize> packed;
+        packed.Fill(0);
+        size_t word_count = WordCount(entry);
+        for (size_t i = 0; i < BlockSize && entry.bitWidth != 0; ++i) {
+            uint64_t value = monotone ? (i == 0 ? 0 : tail[i] - tail[i - 1]) : tail[i] - min;
+            size_t bit = i * entry.bitWidth;
+            size_t word = bit / WordBits;
+            size_t shift = bit % WordBits;
+            packed[word] |= value << shift;
+            if (shift + entry.bitWidth > WordBits) {
+                packed[word + 1] |= value >> (WordBits - shift);
+            }
+        }
+
+        words_.Append(core::Span<const uint64_t>{packed.Data(), word_count});
+        blocks_.PushBack(entry);
+    }
+
+    CustomVectorFile<uint64_t, Metadata> words_;
+    VectorFile<BlockEntry> blocks_;
+};
+
+}  // namespace core
+
+#endif
@@ -0,0 +1,176 @@
+/**
+ * @file hot_swap.h
+ * @brief Replaceable handle to a read-mostly resource, swapped without
+ * blocking readers
+ *
+ */
+
+#ifndef LIB_HOT_SWAP_H
+#define LIB_HOT_SWAP_H
+
+#include "core/locks.h"
+#include "core/mutex.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <sched.h>
+#include <stdexcept>
+#include <utility>
+
+namespace core {
+
+/**
+ * @brief HotSwap holds the current version of a resource, such as a
+ * MemMapFile or SectionFile over an index segment, and lets it be replaced
+ * while readers keep using it, in the manner of RCU.
+ *
+ * Readers pin the current version with Acquire, which takes no locks: it
+ * registers with the version's reader count and checks the version is still
+ * current, retrying only if a reload was published in between. A reload
+ * builds the new version first (mapping and prefaulting it in the
+ * constructor), publishes it atomically, and destroys the old version once
+ * the readers still pinning it have let go. New readers see the new version
+ * as soon as it is published, so serving never pauses.
+ *
+ * Two slots alternate between current and previous, so a reload waits for
+ * the previous-but-one version's stragglers before reusing its slot.
+ *
+ * @tparam T Resource type
+ */
+template<typename T>
+class HotSwap {
+    struct alignas(64) Slot {
+        std::unique_ptr<T> value;
+        std::atomic<uint64_t> readers{0};
+    };
+
+public:
+    /**
+     * @brief Keeps a version pinned while it is held. Valid across reloads;
+     * holding it delays destroying the version it pins. A thread must not
+     * call Reload or Emplace while it holds a Pin, since the reload would
+     * wait for that Pin to be released and deadlock.
+     */
+    class Pin {
+    public:
+        Pin(const Pin&) = delete;
+        Pin& operator=(const Pin&) = delete;
+
+        Pin(Pin&& other) noexcept : slot_(std::exchange(other.slot_, nullptr)) {}
+
+        ~Pin() {
+            if (slot_ != nullptr) {
+                slot_->readers.fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+        const T& operator*() const { return *slot_->value; }
+        const T* operator->() const { return slot_->value.get(); }
+        const T* Get() const { return slot_->value.get(); }
+
+    private:
+        friend class HotSwap;
+
+        explicit Pin(Slot* slot) : slot_(slot) {}
+
+        Slot* slot_;
+    };
+
+    /**
+     * @param initial First version
+     */
+    explicit HotSwap(std::unique_ptr<T> initial) {
+        if (initial == nullptr) {
+            throw std::invalid_argument("hot swap needs an initial value");
+        }
+        slots_[0].value = std::move(initial);
+    }
+
+    HotSwap(const HotSwap&) = delete;
+    HotSwap& operator=(const HotSwap&) = delete;
+
+    /**
+     * @brief Pins the current version. Safe to call from any thread, alongside
+     * a reload.
+     */
+    Pin Acquire() const {
+        while (true) {
+            uint32_t current = current_.load();
+            Slot& slot = slots_[current];
+            slot.readers.fetch_add(1);
+            // The slot is only safe to read if it was still current once the
+            // reload saw this reader registered
+            if (current_.load() == current) {
+                return Pin{&slot};
+            }
+            slot.readers.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    /**
+     * @brief Number of reloads published so far.
+     */
+    uint64_t Generation() const { return generation_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Publishes a new version, then waits for readers of the old one
+     * to drain and destroys it. Reloads are serialized. Deadlocks if the
+     * calling thread holds a Pin.
+     *
+     * @param next New version
+     */
+    void Reload(std::unique_ptr<T> next) {
+        if (next == nullptr) {
+            throw std::invalid_argument("hot swap cannot reload to null");
+        }
+
+        LockGuard lock(reload_mutex_);
+        uint32_t old = current_.load(std::memory_order_relaxed);
+        Slot& spare = slots_[1 - old];
+        // Readers that raced an earlier reload may still be backing out
+        Drain(spare);
+        spare.value = std::move(next);
+
+        current_.store(1 - old);
+        generation_.fetch_add(1, std::memory_order_release);
+
+        Drain(slots_[old]);
+        slots_[old].value.reset();
+    }
+
+    /**
+     * @brief Constructs a new version in place of the current one. The
+     * version is fully constructed before it is published.
+     *
+     * @param args Arguments to construct T with
+     */
+    template<typename... Args>
+    void Emplace(Args&&... args) {
+        Reload(std::make_unique<T>(std::forward<Args>(args)...));
+    }
+
+private:
+    static constexpr size_t SpinsBeforeYield = 64;
+
+    static void Drain(const Slot& slot) {
+        // Pairs with Acquire, which registers and then re-reads current_:
+        // with both sides sequentially consistent, either the reader sees the
+        // new current_ and backs out, or this load sees the reader
+        for (size_t spins = 0; slot.readers.load(std::memory_order_seq_cst) != 0; ++spins) {
+            if (spins >= SpinsBeforeYield) {
+                sched_yield();
+            }
+        }
+    }
+
+    mutable Slot slots_[2];
+    std::atomic<uint32_t> current_{0};
+    std::atomic<uint64_t> generation_{0};
+    core::Mutex reload_mutex_;
+};
+
+}  // namespace core
+
+#endif
@@ -0,0 +1,84 @@
+/**
+ * @file mapping.h
+ * @brief Helpers shared by the memory-mapped data structures
+ *
+ */
+
+#ifndef LIB_MAPPING_H
+#define LIB_MAPPING_H
+
+#include <cstddef>
+
+namespace core {
+
+/**
+ * @brief Size of a transparent huge page on x86-64 and aarch64 (4 KiB base
+ * pages).
+ */
+constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
+/**
+ * @brief Size of a base page on this system, as reported by sysconf. Not
+ * 4 KiB everywhere: some arm64 and ppc64 kernels use 16 or 64 KiB pages.
+ */
+size_t SystemPageSize();
+
+/**
+ * @brief Writes a whole buffer at an offset of a file, retrying short and
+ * interrupted writes.
+ *
+ * @param fd File to write to
+ * @param data Bytes to write
+ * @param length Number of bytes to write
+ * @param offset File offset to write at
+ * @throws std::runtime_error if a write fails
+ */
+void WriteAt(int fd, const void* data, size_t length, size_t offset);
+
+/**
+ * @brief Reserves an inaccessible range of virtual address space without
+ * committing memory. Files can later be mapped into it with MAP_FIXED.
+ *
+ * @param length Bytes to reserve, a multiple of the page size
+ * @param alignment Required alignment of the start address, a power of two
+ * @return void* Start of reservation, or nullptr on failure
+ */
+void* ReserveAddressSpace(size_t length, size_t alignment);
+
+/**
+ * @brief Advises the kernel to back the address range [addr, addr + length)
+ * with transparent huge pages. A no-op on systems without MADV_HUGEPAGE.
+ *
+ * @param addr Start of range, page aligned
+ * @param length Length of range in bytes
+ */
+void AdviseHugePages(void* addr, size_t length);
+
+/**
+ * @brief Reports how many bytes of the address range [addr, addr + length)
+ * are currently mapped with huge pages, according to /proc/self/smaps.
+ * Mappings partially covered by the range are counted proportionally.
+ *
+ * @param addr Start of range
+ * @param length Length of range in bytes
+ * @return size_t Huge-page-backed bytes, 0 if unavailable
+ */
+size_t HugePageBackedBytes(const void* addr, size_t length);
+
+/**
+ * @brief Reports which pages of the address range [addr, addr + length) are
+ * resident in memory, according to mincore.
+ *
+ * @param addr Start of range, page aligned
+ * @param length Length of range in bytes
+ * @param resident Receives one byte per page, with the low bit set if
+ * resident; the other bits are reserved. Must hold length / SystemPageSize()
+ * bytes, rounded up.
+ * @return true Residency was reported
+ * @return false mincore failed; resident is zeroed
+ */
+bool PageResidency(const void* addr, size_t length, unsigned char* resident);
+
+}  // namespace core
+
+#endif
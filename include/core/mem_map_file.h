@@ -12,6 +12,12 @@
 #ifndef LIB_MEM_MAP_FILE_H
 #define LIB_MEM_MAP_FILE_H
 
+#include "core/mutex.h"
+#include "core/thread.h"
+#include "core/vector.h"
+
+#include <atomic>
+#include <cstddef>
 #include <stdexcept>
 #include <string>
 
@@ -27,9 +33,53 @@ private:
     std::string what_;
 };
 
+/**
+ * @brief How forceInMemory faults the pages of a MemMapFile in.
+ *
+ * Touch: reads one byte of every page.
+ *
+ * Populate: asks the kernel to fault in whole ranges with
+ * MADV_POPULATE_READ, falling back to Touch on systems without it.
+ */
+enum class Prefault { Touch, Populate };
+
+struct MemMapFileOptions {
+    /**
+     * @brief Lock the mapping in memory and fault in every page at open.
+     */
+    bool forceInMemory{true};
+
+    /**
+     * @brief How pages are faulted in under forceInMemory.
+     */
+    Prefault prefault{Prefault::Touch};
+
+    /**
+     * @brief Threads faulting pages in, each taking the next unclaimed chunk
+     * of the file.
+     */
+    size_t prefaultThreads{1};
+
+    /**
+     * @brief Return from the constructor right away and fault pages in on
+     * background threads. The mapping is usable throughout; pages not yet
+     * faulted in are read from disk on first access. See PrefaultedBytes()
+     * and WaitForWarmup().
+     */
+    bool asyncPrefault{false};
+
+    /**
+     * @brief Place the mapping on a 2 MiB boundary and madvise it
+     * MADV_HUGEPAGE, so the kernel may back it with transparent huge pages.
+     * See HugePageBytes() for how much actually is.
+     */
+    bool hugePages{false};
+};
+
 class MemMapFile {
 public:
     MemMapFile(const std::string& path, bool forceInMemory = true);
+    MemMapFile(const std::string& path, MemMapFileOptions options);
 
     MemMapFile(const MemMapFile&) = delete;
     MemMapFile& operator=(const MemMapFile&) = delete;
@@ -39,10 +89,64 @@ public:
     const char* data() const noexcept { return data_; }
     size_t size() const noexcept { return size_; }
 
+    /**
+     * @brief Descriptor of the mapped file, for advice such as posix_fadvise
+     * on ranges of it. The mapping starts at offset 0.
+     */
+    int FileDescriptor() const noexcept { return fd_; }
+
+    /**
+     * @brief Number of bytes of the mapping currently backed by huge pages.
+     */
+    size_t HugePageBytes() const;
+
+    /**
+     * @brief Whether forceInMemory locked the mapping in memory. Locking fails
+     * when it would exceed RLIMIT_MEMLOCK; the pages are still faulted in.
+     */
+    bool Locked() const noexcept { return locked_; }
+
+    /**
+     * @brief Number of bytes faulted in so far by warm-up.
+     */
+    size_t PrefaultedBytes() const noexcept { return prefaulted_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Whether warm-up has finished, or was never requested.
+     */
+    bool WarmedUp() const noexcept { return pending_chunks_.load(std::memory_order_acquire) == 0; }
+
+    /**
+     * @brief Blocks until background warm-up has finished. Safe to call from
+     * several threads at once, but every call must return before the file is
+     * destroyed.
+     */
+    void WaitForWarmup();
+
+    /**
+     * @brief Fraction of the mapping's pages resident in memory, according to
+     * mincore.
+     */
+    double ResidentFraction() const;
+
 private:
+    /**
+     * @brief Faults in chunks of the mapping until none are left unclaimed.
+     */
+    void PrefaultChunks(Prefault prefault);
+
     int fd_{-1};
     const char* data_{nullptr};
     size_t size_{0};
+    size_t mapped_length_{0};
+    bool locked_{false};
+
+    std::atomic<size_t> next_chunk_{0};      // next chunk to claim
+    std::atomic<size_t> pending_chunks_{0};  // chunks not yet faulted in
+    std::atomic<size_t> prefaulted_{0};      // bytes faulted in
+    std::atomic<bool> stop_{false};          // abandon warm-up
+    core::Mutex warmers_mutex_;  // serializes joining the warm-up threads
+    core::Vector<core::Thread> warmers_;
 };
 
 }  // namespace core
@@ -2,10 +2,28 @@
 #define CORE_ORDERED_MAP_FILE_H
 
 #include "core/array.h"
+#include "core/mapping.h"
 #include "core/optional.h"
+#include "core/span.h"
+#include "core/vector.h"
 #include "core/vector_file.h"
+#include "core/vector_file_writer.h"
+#include "core/internal/key_search.h"
 
+#include <algorithm>
+#include <atomic>
 #include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <sched.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <type_traits>
+#include <utility>
 
 namespace core {
 
@@ -15,8 +33,40 @@ concept TotalOrderComparator = requires(T t, A a, B b) {
 };
 
 /**
- * @brief OrderedMapFile is a implementation of a insert-only B+ tree that is
- * backed by a memory-mapped file.
+ * @brief Comparator ordering keys by operator<, or by std::cmp_less for two
+ * integers, so mixed signedness compares by value. OrderedMapFile searches
+ * nodes of 32- and 64-bit integer keys under this ordering with vector
+ * compares rather than binary search.
+ */
+struct NaturalOrder {
+    template<typename A, typename B>
+    constexpr int operator()(const A& a, const B& b) const {
+        if constexpr (internal::StandardInteger<A> && internal::StandardInteger<B>) {
+            if (std::cmp_less(a, b)) {
+                return -1;
+            }
+            return std::cmp_greater(a, b) ? 1 : 0;
+        } else {
+            if (a < b) {
+                return -1;
+            }
+            return b < a ? 1 : 0;
+        }
+    }
+};
+
+/**
+ * @brief OrderedMapFile is a implementation of a B+ tree that is backed by a
+ * memory-mapped file. Nodes emptied by erasure are merged away and reused.
+ *
+ * Each node keeps its keys contiguous, apart from the child indices or
+ * values, so searching a node only touches key cache lines. With integer keys
+ * and the NaturalOrder comparator, nodes are searched with SIMD compares.
+ *
+ * One writer may run alongside any number of threads calling Get. Every node
+ * carries a version that the writer makes odd while modifying it, and readers
+ * validate the versions of the nodes they pass through, retrying the lookup
+ * on a change, so reads take no locks.
  *
  * @tparam K Key type
  * @tparam V Value type
@@ -28,8 +78,12 @@ template<typename K, typename V, size_t N, TotalOrderComparator<K, K> Compare>
 class OrderedMapFile {
     using index_t = uint32_t;
 
+    static_assert(N >= 4, "nodes must hold at least four entries");
+
     struct Metadata {
         uint32_t size;
+        index_t freeHead;       // First reclaimed node, 0 if none
+        uint64_t versionClock;  // Last version handed out, halved
     };
 
     struct KV {
@@ -43,9 +97,61 @@ class OrderedMapFile {
     struct Node {
         uint32_t isLeaf;
         uint32_t keyCount;
-        core::Array<KV, N> entries;
+        index_t next;  // Next leaf in key order, or next free node; 0 if none
+        // Odd while being written. Versions come from a clock shared by all
+        // nodes, so a node never returns to a version a reader saw before.
+        uint64_t version;
+        core::Array<K, N> keys;
+        union {
+            core::Array<index_t, N> children;  // Internal node
+            core::Array<V, N> values;          // Leaf node
+        };
+
+        /**
+         * @brief A node with no entries and every field initialized.
+         */
+        static Node Make(uint32_t is_leaf, uint32_t key_count = 0, index_t next = 0) {
+            return Node{
+                .isLeaf = is_leaf,
+                .keyCount = key_count,
+                .next = next,
+                .version = 0,
+                .keys = {},
+                .children = {},
+            };
+        }
+
+        void SetEntry(uint32_t pos, const KV& kv) {
+            keys[pos] = kv.key;
+            if (isLeaf) {
+                values[pos] = kv.value;
+            } else {
+                children[pos] = kv.childIndex;
+            }
+        }
+
+        /**
+         * @brief Copies an entry of a node of the same kind into this one.
+         */
+        void CopyEntry(uint32_t pos, const Node& src, uint32_t src_pos) {
+            keys[pos] = src.keys[src_pos];
+            if (isLeaf) {
+                values[pos] = src.values[src_pos];
+            } else {
+                children[pos] = src.children[src_pos];
+            }
+        }
     };
 
+    /**
+     * @brief Whether nodes can be searched for a key with SIMD compares.
+     */
+    template<typename ComparableKey>
+    static constexpr bool VectorSearchable = std::same_as<Compare, NaturalOrder> &&
+                                             internal::SimdSearchableKey<K> && std::same_as<ComparableKey, K>;
+
+    static constexpr index_t NoNode = UINT32_MAX;
+
     struct Split {
         index_t left;
         index_t right;
@@ -73,18 +179,105 @@ public:
         const V* value;
     };
 
+    /**
+     * @brief Forward iterator over the map's pairs in key order. Walks the
+     * chain of leaves without returning to the root. Invalidated by
+     * insertion.
+     */
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = ConstPair;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = ConstPair;
+
+        Iterator() = default;
+
+        ConstPair operator*() const {
+            const Node& node = map_->nodes_[node_];
+            return ConstPair{.key = &node.keys[pos_], .value = &node.values[pos_]};
+        }
+
+        Iterator& operator++() {
+            const Node& node = map_->nodes_[node_];
+            if (++pos_ == node.keyCount) {
+                map_->SeekLeaf(node.next, *this);
+            }
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const Iterator& other) const { return node_ == other.node_ && pos_ == other.pos_; }
+
+    private:
+        friend class OrderedMapFile;
+
+        Iterator(const OrderedMapFile* map, index_t node, uint32_t pos) : map_(map), node_(node), pos_(pos) {}
+
+        const OrderedMapFile* map_{nullptr};
+        index_t node_{NoNode};
+        uint32_t pos_{0};
+    };
+
+    /**
+     * @brief Half-open range of pairs, usable in range-based for loops.
+     */
+    struct PairRange {
+        Iterator first;
+        Iterator last;
+
+        Iterator begin() const { return first; }
+        Iterator end() const { return last; }
+    };
+
+    /**
+     * @brief Shape of one level of the tree.
+     */
+    struct LevelStats {
+        size_t nodes;
+        size_t keys;
+        size_t residentNodes;  // Nodes whose pages are all resident in memory
+        double fillFactor;     // Keys per node, as a fraction of N
+    };
+
+    /**
+     * @brief Structure of the tree, as reported by Stats().
+     */
+    struct TreeStats {
+        size_t size;
+        size_t depth;
+        size_t nodeCount;  // Nodes in the file, free ones included
+        size_t freeNodes;
+        size_t nodeBytes;  // Bytes per node
+        size_t internalBytes;
+        size_t leafBytes;
+        double leafFillFactor;
+        core::Array<size_t, 10> leafFillHistogram;  // Leaves by fill, in tenths of N
+        core::Vector<K> keyDeciles;                  // Minimum, nine deciles and maximum key; empty if no keys
+        core::Vector<LevelStats> levels;             // Root first
+    };
+
     /**
      * @brief Creates or opens a OrderedMapFile at the given path.
      *
      * @param path Path of backing file
      * @param compare Comparator to use for maintaining ordering
+     * @param options Options for the backing node file. A read-only map must
+     * already exist, its modifying operations throw std::runtime_error, and it
+     * should be opened through ReadOnlyFile so that values cannot be written
+     * in place. The layout version is set by the map, so files with an older
+     * node layout are refused.
      */
-    OrderedMapFile(const char* path, Compare compare) : nodes_(path), compare_(compare) {
-        if (nodes_.Empty()) {
-            nodes_.PushBack(Node{
-                .isLeaf = 1,
-                .keyCount = 0,
-            });
+    OrderedMapFile(const char* path, Compare compare, VectorFileOptions options = {})
+        : nodes_(path, NodeFileOptions(options)), compare_(compare), path_(path), options_(NodeFileOptions(options)) {
+        if (nodes_.Empty() && !nodes_.ReadOnly()) {
+            nodes_.PushBack(Node::Make(1));
         }
     }
 
@@ -100,25 +293,26 @@ public:
      * @return false Insertion did not occur -- key already present
      */
     bool Insert(K key, V val) {
+        if (nodes_.ReadOnly()) {
+            throw std::runtime_error("ordered map file is read-only");
+        }
+        WriteScope scope(*this);
+
         auto result = InsertInto(0, key, val);
         if (!result.inserted) {
             return false;
         }
 
         if (result.split) {
-            // Root node was split, update with new root
+            // Root node was split; move its left half out so the new root can
+            // stay at index 0
             assert(result.split->left == 0);
-            Node old_root = nodes_[0];
-            Node new_root = Node{
-                .isLeaf = 0,
-                .keyCount = 2,
-            };
-            new_root.entries[0].key = old_root.entries[0].key;
-            new_root.entries[0].childIndex = nodes_.Size();
-            new_root.entries[1].key = result.split->key;
-            new_root.entries[1].childIndex = result.split->right;
-            nodes_.PushBack(new_root);
-            std::swap(nodes_.Front(), nodes_.Back());
+            Node new_root = Node::Make(0, 2);
+            new_root.keys[0] = nodes_[0].keys[0];
+            new_root.children[0] = AllocateNode(nodes_[0]);
+            new_root.keys[1] = result.split->key;
+            new_root.children[1] = result.split->right;
+            StoreNode(0, new_root);
         }
 
         // Increment number of elements in map
@@ -128,7 +322,142 @@ public:
     }
 
     /**
-     * @brief Finds a key-value pair in the map.
+     * @brief Inserts a key-value pair, or assigns the value if the key is
+     * already present.
+     *
+     * @param key Key to insert
+     * @param val Value to insert or assign
+     * @return true Insertion occurred
+     * @return false Existing value was assigned
+     */
+    bool InsertOrAssign(K key, V val) {
+        return Upsert(key, [&](V& value) { value = val; });
+    }
+
+    /**
+     * @brief Updates the value of a key in place, inserting it first if
+     * absent. The update is applied to the stored value directly when the key
+     * is present, and to a value-initialized V that is then inserted
+     * otherwise.
+     *
+     * @param key Key to update
+     * @param update Invoked with a V& to modify
+     * @return true Insertion occurred
+     * @return false Existing value was updated
+     */
+    template<typename Update>
+        requires std::invocable<Update&, V&>
+    bool Upsert(K key, Update update) {
+        if (nodes_.ReadOnly()) {
+            throw std::runtime_error("ordered map file is read-only");
+        }
+        WriteScope scope(*this);
+        if (auto found = FindImpl(key)) {
+            update(WriteNode(found->node).values[found->entry]);
+            return false;
+        }
+        V value{};
+        update(value);
+        return Insert(key, value);
+    }
+
+    /**
+     * @brief Erases a key from the map. Nodes left less than half full borrow
+     * from or merge with a sibling, and nodes freed by merging are reused by
+     * later insertions.
+     *
+     * @param key Key to erase
+     * @return true Key was erased
+     * @return false Key was not present
+     */
+    template<typename ComparableKey>
+        requires TotalOrderComparator<Compare, K, ComparableKey>
+    bool Erase(const ComparableKey& key) {
+        if (nodes_.ReadOnly()) {
+            throw std::runtime_error("ordered map file is read-only");
+        }
+        WriteScope scope(*this);
+        if (Empty() || !EraseFrom(0, key)) {
+            return false;
+        }
+
+        // Collapse a root left with a single child
+        if (!nodes_[0].isLeaf && nodes_[0].keyCount == 1) {
+            index_t child = nodes_[0].children[0];
+            StoreNode(0, nodes_[child]);
+            FreeNode(child);
+        }
+
+        --nodes_.CustomData()->size;
+        return true;
+    }
+
+    /**
+     * @brief Builds the tree bottom-up from key-value pairs sorted by key, in
+     * one sequential pass. Leaves and internal nodes are written as they
+     * fill, so there are no splits, and every node but the last of each
+     * level holds the same number of entries. The map must be empty.
+     *
+     * @param first Start of range of pairs with key in first, value in second
+     * @param last End of range
+     * @param fillFactor Fraction of each node to fill, in [0.5, 1]. Less than
+     * full leaves room for later inserts without immediate splits.
+     * @return size_t Number of pairs loaded
+     */
+    template<std::input_iterator It>
+    size_t BulkLoad(It first, It last, double fillFactor = 1.0) {
+        if (nodes_.ReadOnly()) {
+            throw std::runtime_error("ordered map file is read-only");
+        }
+        if (!Empty()) {
+            throw std::runtime_error("bulk load requires an empty map");
+        }
+        WriteScope scope(*this);
+        Reset();
+
+        fillFactor = std::clamp(fillFactor, 0.5, 1.0);
+        // Internal nodes must keep a free slot, as insertion splits them only
+        // once they become full
+        auto leaf_fill = std::clamp<uint32_t>(static_cast<uint32_t>(fillFactor * N), 1, N);
+        auto internal_fill = std::clamp<uint32_t>(static_cast<uint32_t>(fillFactor * (N - 1)), 2, N - 1);
+
+        core::Vector<BulkLevel> levels;
+        levels.push_back(BulkLevel{.node = Node::Make(1)});
+
+        size_t count = 0;
+        try {
+            for (; first != last; ++first) {
+                const auto& entry = *first;
+                const BulkLevel& leaves = levels[0];
+                if (count > 0 && compare_(leaves.node.keys[leaves.node.keyCount - 1], entry.first) >= 0) {
+                    throw std::invalid_argument("bulk load input must be sorted with unique keys");
+                }
+
+                if (levels[0].node.keyCount == leaf_fill) {
+                    BulkPushNode(levels, 0, internal_fill);
+                }
+                Node& leaf = levels[0].node;
+                leaf.keys[leaf.keyCount] = entry.first;
+                leaf.values[leaf.keyCount++] = entry.second;
+                ++count;
+            }
+
+            if (count > 0) {
+                BulkFinish(levels, internal_fill);
+            }
+        } catch (...) {
+            // Leave the map empty
+            Reset();
+            throw;
+        }
+
+        nodes_.CustomData()->size = count;
+        return count;
+    }
+
+    /**
+     * @brief Finds a key-value pair in the map, with the value writable in
+     * place.
      *
      * @param key Key to look up
      * @return Found pair, if key is in map.
@@ -138,8 +467,8 @@ public:
     core::Optional<Pair> Find(const ComparableKey& key) {
         if (auto found = FindImpl(key)) {
             return Pair{
-                .key = &nodes_[found->node].entries[found->entry].key,
-                .value = &nodes_[found->node].entries[found->entry].value,
+                .key = &nodes_[found->node].keys[found->entry],
+                .value = &nodes_[found->node].values[found->entry],
             };
         }
         return core::nullopt;
@@ -156,13 +485,87 @@ public:
     core::Optional<ConstPair> Find(const ComparableKey& key) const {
         if (auto found = FindImpl(key)) {
             return ConstPair{
-                .key = &nodes_[found->node].entries[found->entry].key,
-                .value = &nodes_[found->node].entries[found->entry].value,
+                .key = &nodes_[found->node].keys[found->entry],
+                .value = &nodes_[found->node].values[found->entry],
             };
         }
         return core::nullopt;
     }
 
+    Iterator begin() const {
+        index_t node_index = 0;
+        while (!nodes_[node_index].isLeaf) {
+            node_index = nodes_[node_index].children[0];
+        }
+        Iterator it{this, NoNode, 0};
+        if (nodes_[node_index].keyCount > 0) {
+            it.node_ = node_index;
+            PrefetchNext(node_index);
+        }
+        return it;
+    }
+
+    Iterator end() const { return Iterator{this, NoNode, 0}; }
+
+    /**
+     * @brief Finds the first pair whose key is not less than the given key.
+     *
+     * @param key Key to search for
+     * @return Iterator Position of pair, or end() if none
+     */
+    template<typename ComparableKey>
+        requires TotalOrderComparator<Compare, K, ComparableKey>
+    Iterator LowerBound(const ComparableKey& key) const {
+        index_t node_index = FindLeaf(key);
+        uint32_t pos = FindPosition(nodes_[node_index], key);
+        Iterator it{this, NoNode, 0};
+        if (pos < nodes_[node_index].keyCount) {
+            it.node_ = node_index;
+            it.pos_ = pos;
+            PrefetchNext(node_index);
+        } else {
+            SeekLeaf(nodes_[node_index].next, it);
+        }
+        return it;
+    }
+
+    /**
+     * @brief Finds the first pair whose key is greater than the given key.
+     *
+     * @param key Key to search for
+     * @return Iterator Position of pair, or end() if none
+     */
+    template<typename ComparableKey>
+        requires TotalOrderComparator<Compare, K, ComparableKey>
+    Iterator UpperBound(const ComparableKey& key) const {
+        Iterator it = LowerBound(key);
+        if (it != end() && compare_(*(*it).key, key) == 0) {
+            ++it;
+        }
+        return it;
+    }
+
+    /**
+     * @brief Gets the pairs with keys in [lo, hi), in key order.
+     *
+     * @param lo Inclusive lower bound
+     * @param hi Exclusive upper bound
+     * @return PairRange Range of pairs
+     */
+    template<typename ComparableKey>
+        requires TotalOrderComparator<Compare, K, ComparableKey>
+    PairRange Range(const ComparableKey& lo, const ComparableKey& hi) const {
+        Iterator first = LowerBound(lo);
+        Iterator last = LowerBound(hi);
+        // Empty when no key reaches lo, or when hi < lo. The bounds are
+        // compared through the keys they land on, as the comparator need only
+        // order keys against a ComparableKey
+        if (first == end() || (last != end() && compare_(*(*first).key, *(*last).key) > 0)) {
+            return {last, last};
+        }
+        return {first, last};
+    }
+
     /**
      * @brief Checks whether a key is present in the map.
      *
@@ -175,7 +578,775 @@ public:
         return FindImpl(key).HasValue();
     }
 
+    /**
+     * @brief Makes every write to the map so far durable. Nodes are modified
+     * in place, so every node is synced, not only newly allocated ones.
+     */
+    void Sync() {
+        if (nodes_.ReadOnly()) {
+            throw std::runtime_error("ordered map file is read-only");
+        }
+        nodes_.Sync();
+    }
+
+    /**
+     * @brief Finds many keys at once. Lookups are grouped and descend the tree
+     * in lockstep, one level at a time, prefetching each lookup's next node
+     * before moving on to the others, so the cache misses of a group overlap
+     * instead of being taken one after another. Sorted keys additionally
+     * share the nodes near the root and their neighbours' leaves.
+     *
+     * @param keys Keys to look up
+     * @param out Receives the found pair, if any, for each key, in order. Must
+     * be at least as long as keys.
+     */
+    template<typename ComparableKey>
+        requires TotalOrderComparator<Compare, K, ComparableKey>
+    void FindMany(core::Span<const ComparableKey> keys, core::Span<core::Optional<ConstPair>> out) const {
+        if (out.Size() < keys.Size()) {
+            throw std::invalid_argument("output span shorter than keys");
+        }
+        for (size_t first = 0; first < keys.Size(); first += FindManyGroup) {
+            size_t count = std::min(FindManyGroup, keys.Size() - first);
+            FindGroup(&keys[first], &out[first], count);
+        }
+    }
+
+    /**
+     * @brief Looks up the value of a key without taking any lock. Safe to call
+     * from any number of threads while one other thread modifies the map,
+     * provided the map was opened with a stable address
+     * (VectorFileOptions::reserveBytes) so growth never moves the nodes. A map
+     * with a stable address never shrinks its file either: freed nodes,
+     * including the last, join the free list, so an index a reader still
+     * holds stays mapped. Each node is copied and then validated against its
+     * version, and the lookup restarts from the root if the writer touched a
+     * node on the path. Other lookups, iterators and Compact are not safe
+     * alongside a writer.
+     *
+     * @param key Key to look up
+     * @return Copy of the value, if key is in map.
+     * @throws std::runtime_error If the map does not have a stable address
+     */
+    template<typename ComparableKey>
+        requires TotalOrderComparator<Compare, K, ComparableKey>
+    core::Optional<V> Get(const ComparableKey& key) const {
+        if (!nodes_.StableAddress()) {
+            throw std::runtime_error("lock-free get requires a stable address");
+        }
+        const Node* nodes = nodes_.Data();
+        while (true) {
+            index_t node_index = 0;
+            uint64_t version = ReadVersion(nodes[0]);
+            bool restart = false;
+            while (!restart) {
+                // Search a private copy, so a torn read is never acted on
+                Node node{};
+                std::memcpy(static_cast<void*>(&node), &nodes[node_index], sizeof(Node));
+                if (!ValidateVersion(nodes[node_index], version)) {
+                    break;
+                }
+
+                auto pos = FindPosition(node, key);
+                bool exact_key_match = pos < node.keyCount && compare_(node.keys[pos], key) == 0;
+                if (node.isLeaf) {
+                    if (exact_key_match) {
+                        return node.values[pos];
+                    }
+                    return core::nullopt;
+                }
+                index_t child = node.children[exact_key_match || pos == 0 ? pos : pos - 1];
+                uint64_t child_version = ReadVersion(nodes[child]);
+                // Child is only known to belong to this node while it is
+                // unchanged
+                restart = !ValidateVersion(nodes[node_index], version);
+                node_index = child;
+                version = child_version;
+            }
+        }
+    }
+
+    /**
+     * @brief Walks the tree level by level and reports its depth, node counts
+     * and fill, the bytes held by internal nodes and by leaves, how keys are
+     * distributed, and how much of each level is resident in memory.
+     *
+     * @return TreeStats Structure of the tree
+     */
+    TreeStats Stats() const {
+        TreeStats stats{
+            .size = Size(),
+            .depth = 0,
+            .nodeCount = nodes_.Size(),
+            .freeNodes = 0,
+            .nodeBytes = sizeof(Node),
+            .internalBytes = 0,
+            .leafBytes = 0,
+            .leafFillFactor = 0,
+            .leafFillHistogram = {},
+            .keyDeciles = {},
+            .levels = {},
+        };
+        stats.leafFillHistogram.Fill(0);
+        for (index_t node_index = nodes_.CustomData()->freeHead; node_index != 0;
+             node_index = nodes_[node_index].next) {
+            ++stats.freeNodes;
+        }
+
+        // Residency of every page backing a node
+        const char* base = reinterpret_cast<const char*>(nodes_.Data()) - decltype(nodes_)::HeaderSpace;
+        size_t mapped_bytes = decltype(nodes_)::HeaderSpace + (nodes_.Size() * sizeof(Node));
+        size_t page_size = SystemPageSize();
+        core::Vector<unsigned char> resident((mapped_bytes + page_size - 1) / page_size);
+        PageResidency(base, mapped_bytes, resident.data());
+        auto is_resident = [&](index_t node_index) {
+            size_t begin = decltype(nodes_)::HeaderSpace + (node_index * sizeof(Node));
+            for (size_t page = begin / page_size; page <= (begin + sizeof(Node) - 1) / page_size; page++) {
+                // Only the low bit is defined; the rest are reserved
+                if ((resident[page] & 1) == 0) {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        core::Vector<index_t> level{0};
+        size_t rank = 0;  // Keys seen so far on the leaf level
+        while (!level.empty()) {
+            LevelStats level_stats{.nodes = level.size(), .keys = 0, .residentNodes = 0, .fillFactor = 0};
+            core::Vector<index_t> next_level;
+            for (index_t node_index : level) {
+                const Node& node = nodes_[node_index];
+                level_stats.keys += node.keyCount;
+                level_stats.residentNodes += static_cast<size_t>(is_resident(node_index));
+                if (!node.isLeaf) {
+                    for (uint32_t i = 0; i < node.keyCount; i++) {
+                        next_level.push_back(node.children[i]);
+                    }
+                    continue;
+                }
+
+                ++stats.leafFillHistogram[std::min<size_t>(node.keyCount * 10 / N, 9)];
+                // Leaves are visited in key order
+                while (stats.keyDeciles.size() < 11 && stats.size > 0) {
+                    size_t target = (stats.size - 1) * stats.keyDeciles.size() / 10;
+                    if (target >= rank + node.keyCount) {
+                        break;
+                    }
+                    stats.keyDeciles.push_back(node.keys[target - rank]);
+                }
+                rank += node.keyCount;
+            }
+            level_stats.fillFactor = static_cast<double>(level_stats.keys) / static_cast<double>(level.size() * N);
+
+            bool is_leaf_level = next_level.empty();
+            (is_leaf_level ? stats.leafBytes : stats.internalBytes) += level.size() * sizeof(Node);
+            if (is_leaf_level) {
+                stats.leafFillFactor = level_stats.fillFactor;
+            }
+            stats.levels.push_back(level_stats);
+            level = std::move(next_level);
+        }
+        stats.depth = stats.levels.size();
+        return stats;
+    }
+
+    /**
+     * @brief Rewrites the tree into a new file and swaps it in. Nodes are
+     * filled to fillFactor and laid out level by level, root first, with the
+     * leaves last and in key order, so the upper levels are contiguous and
+     * range scans read the file sequentially. Free nodes are dropped.
+     *
+     * The new file is written beside the old one at path + ".compact",
+     * synced, and renamed over it, so a crash leaves either the old tree or
+     * the new one. If any step throws, the new file is removed and the map is
+     * left as it was. Invalidates iterators and pointers into the map, and must
+     * not run alongside readers.
+     *
+     * @param fillFactor Fraction of each node to fill, clamped to [0.5, 1]
+     */
+    void Compact(double fillFactor = 1.0) {
+        if (nodes_.ReadOnly()) {
+            throw std::runtime_error("ordered map file is read-only");
+        }
+
+        fillFactor = std::clamp(fillFactor, 0.5, 1.0);
+        auto leaf_fill = std::clamp<uint32_t>(static_cast<uint32_t>(fillFactor * N), 1, N);
+        auto internal_fill = std::clamp<uint32_t>(static_cast<uint32_t>(fillFactor * (N - 1)), 2, N - 1);
+
+        // Nodes per level, root first
+        size_t size = Size();
+        core::Vector<size_t> counts{LevelNodes(size, leaf_fill, MinFill(true))};
+        while (counts.back() > 1) {
+            counts.push_back(LevelNodes(counts.back(), internal_fill, MinFill(false)));
+        }
+        std::reverse(counts.begin(), counts.end());
+        size_t leaf_level = counts.size() - 1;
+        size_t leaves = counts[leaf_level];
+
+        core::Vector<index_t> offsets{0};
+        for (size_t level = 0; level < leaf_level; ++level) {
+            offsets.push_back(static_cast<index_t>(offsets.back() + counts[level]));
+        }
+
+        // Entries of the n-th node of a level are spread evenly over it
+        auto first_entry = [&](size_t level, size_t n) {
+            size_t entries = level == leaf_level ? size : counts[level + 1];
+            return n * entries / counts[level];
+        };
+
+        // First key of every new leaf, which internal nodes are keyed by
+        core::Vector<K> leaf_keys;
+        leaf_keys.reserve(leaves);
+        size_t rank = 0;
+        for (auto it = begin(); it != end(); ++it, ++rank) {
+            if (leaf_keys.size() < leaves && rank == first_entry(leaf_level, leaf_keys.size())) {
+                leaf_keys.push_back(*(*it).key);
+            }
+        }
+
+        std::string compact_path = path_ + ".compact";
+        try {
+            {
+                CustomVectorFileWriter<Node, Metadata> writer(
+                    compact_path.c_str(), VectorFileWriterOptions{.layoutVersion = NodeLayoutVersion});
+                *writer.CustomData() = Metadata{
+                    .size = static_cast<uint32_t>(size),
+                    .freeHead = 0,
+                    .versionClock = nodes_.CustomData()->versionClock,
+                };
+
+                for (size_t level = 0; level < leaf_level; ++level) {
+                    for (size_t n = 0; n < counts[level]; ++n) {
+                        Node node{};
+                        size_t child_begin = first_entry(level, n);
+                        size_t child_end = first_entry(level, n + 1);
+                        node.keyCount = static_cast<uint32_t>(child_end - child_begin);
+                        for (size_t child = child_begin; child < child_end; ++child) {
+                            // Leftmost leaf below the child
+                            size_t leaf = child;
+                            for (size_t below = level + 1; below < leaf_level; ++below) {
+                                leaf = first_entry(below, leaf);
+                            }
+                            node.keys[child - child_begin] = leaf_keys[leaf];
+                            node.children[child - child_begin] = static_cast<index_t>(offsets[level + 1] + child);
+                        }
+                        writer.PushBack(node);
+                    }
+                }
+
+                auto it = begin();
+                for (size_t n = 0; n < leaves; ++n) {
+                    Node node{};
+                    node.isLeaf = 1;
+                    node.keyCount = static_cast<uint32_t>(first_entry(leaf_level, n + 1) - first_entry(leaf_level, n));
+                    node.next = n + 1 < leaves ? static_cast<index_t>(offsets[leaf_level] + n + 1) : 0;
+                    for (uint32_t i = 0; i < node.keyCount; ++i, ++it) {
+                        node.keys[i] = *(*it).key;
+                        node.values[i] = *(*it).value;
+                    }
+                    writer.PushBack(node);
+                }
+                writer.Close();
+            }
+
+            // Map the new file before replacing the old one, so a failure
+            // leaves the map as it was
+            CustomVectorFile<Node, Metadata> compacted(compact_path.c_str(), options_);
+            if (std::rename(compact_path.c_str(), path_.c_str()) == -1) {
+                throw std::runtime_error("failed to replace ordered map file");
+            }
+            // The old mapping is released with compacted
+            nodes_.Swap(compacted);
+        } catch (...) {
+            std::remove(compact_path.c_str());
+            throw;
+        }
+    }
+
+    /**
+     * @brief Locks the nodes of the top levels of the tree in memory with
+     * mlock, so lookups never fault on them. After Compact the upper levels
+     * are contiguous at the front of the file and lock as one range. Locks
+     * last until the map is closed or its mapping moves as the file grows.
+     *
+     * @param levels Number of levels to lock, counting the root
+     * @return size_t Bytes locked
+     */
+    size_t LockUpperLevels(size_t levels) const {
+        core::Vector<index_t> locked;
+        core::Vector<index_t> level{0};
+        for (size_t depth = 0; depth < levels && !level.empty(); ++depth) {
+            core::Vector<index_t> next_level;
+            for (index_t node_index : level) {
+                locked.push_back(node_index);
+                const Node& node = nodes_[node_index];
+                for (uint32_t i = 0; !node.isLeaf && i < node.keyCount; ++i) {
+                    next_level.push_back(node.children[i]);
+                }
+            }
+            level = std::move(next_level);
+        }
+        std::sort(locked.begin(), locked.end());
+
+        // Lock runs of nodes as whole page ranges
+        auto base = reinterpret_cast<uintptr_t>(nodes_.Data());
+        size_t bytes = 0;
+        for (size_t i = 0; i < locked.size();) {
+            size_t j = i + 1;
+            while (j < locked.size() && locked[j] == locked[j - 1] + 1) {
+                ++j;
+            }
+            uintptr_t begin = (base + (locked[i] * sizeof(Node))) & ~(PageSize - 1);
+            uintptr_t end = base + ((locked[j - 1] + 1) * sizeof(Node));
+            if (mlock(reinterpret_cast<const void*>(begin), end - begin) == -1) {
+                throw std::runtime_error("failed to lock nodes in memory");
+            }
+            bytes += end - begin;
+            i = j;
+        }
+        return bytes;
+    }
+
 private:
+    /**
+     * @brief Marks the nodes modified by one write operation, and publishes
+     * them with new versions once it completes or throws. Nested scopes defer
+     * to the outermost one.
+     */
+    class WriteScope {
+    public:
+        explicit WriteScope(OrderedMapFile& map) : map_(map) { ++map_.write_depth_; }
+        WriteScope(const WriteScope&) = delete;
+        WriteScope& operator=(const WriteScope&) = delete;
+
+        ~WriteScope() {
+            if (--map_.write_depth_ == 0) {
+                map_.PublishWrites();
+            }
+        }
+
+    private:
+        OrderedMapFile& map_;
+    };
+
+    static std::atomic_ref<uint64_t> VersionOf(const Node& node) {
+        return std::atomic_ref<uint64_t>(const_cast<uint64_t&>(node.version));
+    }
+
+    /**
+     * @brief Waits until no write is in progress on a node and returns its
+     * version.
+     */
+    static uint64_t ReadVersion(const Node& node) {
+        for (size_t spins = 0;; ++spins) {
+            uint64_t version = VersionOf(node).load(std::memory_order_acquire);
+            if (version % 2 == 0) {
+                return version;
+            }
+            if (spins >= SpinsBeforeYield) {
+                sched_yield();
+            }
+        }
+    }
+
+    /**
+     * @brief Whether a node is unchanged since its version was read.
+     */
+    static bool ValidateVersion(const Node& node, uint64_t version) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return VersionOf(node).load(std::memory_order_relaxed) == version;
+    }
+
+    /**
+     * @brief Draws an unused even version from the clock.
+     */
+    uint64_t NextVersion() { return ++nodes_.CustomData()->versionClock * 2; }
+
+    /**
+     * @brief Gets a node for modification, marking it as being written so
+     * concurrent readers wait or retry. Must be called within a WriteScope.
+     */
+    Node& WriteNode(index_t node_index) {
+        assert(write_depth_ > 0);
+        Node& node = nodes_[node_index];
+        auto version = VersionOf(node);
+        uint64_t current = version.load(std::memory_order_relaxed);
+        if (current % 2 == 0) {
+            version.store(current + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            written_.push_back(node_index);
+        }
+        return node;
+    }
+
+    /**
+     * @brief Overwrites a node in place, keeping its version.
+     */
+    void StoreNode(index_t node_index, Node node) {
+        Node& target = WriteNode(node_index);
+        node.version = target.version;
+        target = node;
+    }
+
+    /**
+     * @brief Gives every node marked by the finished operation a new version.
+     * Nodes truncated away are skipped if their memory is gone; a reused slot
+     * gets a fresh version from the clock anyway.
+     */
+    void PublishWrites() {
+        Node* nodes = nodes_.Data();
+        size_t capacity = nodes_.ReadOnly() ? 0 : nodes_.Capacity();
+        for (index_t node_index : written_) {
+            if (node_index < capacity) {
+                VersionOf(nodes[node_index]).store(NextVersion(), std::memory_order_release);
+            }
+        }
+        written_.clear();
+    }
+
+    /**
+     * @brief Descends from the root to the leaf that would hold a key.
+     */
+    template<typename ComparableKey>
+        requires TotalOrderComparator<Compare, K, ComparableKey>
+    index_t FindLeaf(const ComparableKey& key) const {
+        index_t node_index = 0;
+        while (!nodes_[node_index].isLeaf) {
+            const Node& node = nodes_[node_index];
+            auto pos = FindPosition(node, key);
+            bool exact_key_match = pos < node.keyCount && compare_(node.keys[pos], key) == 0;
+            if (!exact_key_match && pos > 0) {
+                --pos;
+            }
+            node_index = node.children[pos];
+        }
+        return node_index;
+    }
+
+    /**
+     * @brief Positions an iterator at the start of a leaf in the chain, or at
+     * end if there is none.
+     */
+    void SeekLeaf(index_t node_index, Iterator& it) const {
+        it.pos_ = 0;
+        it.node_ = node_index == 0 ? NoNode : node_index;
+        if (node_index != 0) {
+            PrefetchNext(node_index);
+        }
+    }
+
+    /**
+     * @brief Starts loading the leaf after the given one into cache, so a
+     * scan does not stall on it.
+     */
+    void PrefetchNext(index_t node_index) const {
+        index_t next = nodes_[node_index].next;
+        if (next == 0) {
+            return;
+        }
+        PrefetchNode(next, std::min<size_t>(sizeof(Node), 512));
+    }
+
+    /**
+     * @brief Starts loading the first bytes of a node into cache.
+     */
+    void PrefetchNode(index_t node_index, size_t bytes) const {
+        const char* addr = reinterpret_cast<const char*>(nodes_.Data() + node_index);
+        for (size_t offset = 0; offset < bytes; offset += 64) {
+            __builtin_prefetch(addr + offset);
+        }
+    }
+
+    /**
+     * @brief Looks up a group of at most FindManyGroup keys in lockstep. The
+     * tree is balanced, so every lookup reaches the leaves on the same level.
+     */
+    template<typename ComparableKey>
+        requires TotalOrderComparator<Compare, K, ComparableKey>
+    void FindGroup(const ComparableKey* keys, core::Optional<ConstPair>* out, size_t count) const {
+        core::Array<index_t, FindManyGroup> lanes;
+        lanes.Fill(0);
+
+        while (!nodes_[lanes[0]].isLeaf) {
+            for (size_t i = 0; i < count; ++i) {
+                const Node& node = nodes_[lanes[i]];
+                auto pos = FindPosition(node, keys[i]);
+                bool exact_key_match = pos < node.keyCount && compare_(node.keys[pos], keys[i]) == 0;
+                lanes[i] = node.children[exact_key_match || pos == 0 ? pos : pos - 1];
+                PrefetchNode(lanes[i], SearchBytes);
+            }
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            const Node& leaf = nodes_[lanes[i]];
+            auto pos = FindPosition(leaf, keys[i]);
+            if (pos < leaf.keyCount && compare_(leaf.keys[pos], keys[i]) == 0) {
+                out[i] = core::Optional<ConstPair>{ConstPair{.key = &leaf.keys[pos], .value = &leaf.values[pos]}};
+            } else {
+                out[i] = core::nullopt;
+            }
+        }
+    }
+
+    /**
+     * @brief Stores a node in a reclaimed slot if there is one, otherwise at
+     * the end of the file. Takes the node by value, as growing the file may
+     * move the mapping.
+     *
+     * @return index_t Index of stored node
+     */
+    index_t AllocateNode(Node node) {
+        Metadata* meta = nodes_.CustomData();
+        if (meta->freeHead != 0) {
+            index_t node_index = meta->freeHead;
+            meta->freeHead = nodes_[node_index].next;
+            StoreNode(node_index, node);
+            return node_index;
+        }
+        node.version = NextVersion();
+        nodes_.PushBack(node);
+        return static_cast<index_t>(nodes_.Size() - 1);
+    }
+
+    /**
+     * @brief Releases a node no longer referenced by the tree. The last node
+     * in the file is truncated away, unless the map has a stable address and
+     * Get may be reading it; others join the free list.
+     */
+    void FreeNode(index_t node_index) {
+        assert(node_index != 0);
+        if (node_index == nodes_.Size() - 1 && !nodes_.StableAddress()) {
+            // Readers still holding the index see it mid-write, then retry
+            WriteNode(node_index);
+            nodes_.PopBack();
+            return;
+        }
+        Metadata* meta = nodes_.CustomData();
+        StoreNode(node_index, Node::Make(0, 0, meta->freeHead));
+        meta->freeHead = node_index;
+    }
+
+    /**
+     * @brief Empties the tree to a root leaf. The file is truncated, or with a
+     * stable address every other node joins the free list in file order, so
+     * nodes are reused front to back.
+     */
+    void Reset() {
+        if (nodes_.StableAddress()) {
+            index_t head = 0;
+            for (size_t node_index = nodes_.Size() - 1; node_index > 0; --node_index) {
+                StoreNode(node_index, Node::Make(0, 0, head));
+                head = static_cast<index_t>(node_index);
+            }
+            StoreNode(0, Node::Make(1));
+            nodes_.CustomData()->size = 0;
+            nodes_.CustomData()->freeHead = head;
+            return;
+        }
+        while (nodes_.Size() > 1) {
+            WriteNode(nodes_.Size() - 1);
+            nodes_.PopBack();
+        }
+        StoreNode(0, Node::Make(1));
+        nodes_.CustomData()->size = 0;
+        nodes_.CustomData()->freeHead = 0;
+    }
+
+    /**
+     * @brief Erases a key from the subtree rooted at a node, rebalancing the
+     * child it was erased from.
+     *
+     * @return Whether the key was found
+     */
+    template<typename ComparableKey>
+        requires TotalOrderComparator<Compare, K, ComparableKey>
+    bool EraseFrom(index_t node_index, const ComparableKey& key) {
+        const Node& found = nodes_[node_index];
+        auto pos = FindPosition(found, key);
+        if (found.isLeaf) {
+            if (pos == found.keyCount || compare_(found.keys[pos], key) != 0) {
+                return false;
+            }
+            Node& node = WriteNode(node_index);
+            for (uint32_t i = pos; i + 1 < node.keyCount; ++i) {
+                node.CopyEntry(i, node, i + 1);
+            }
+            --node.keyCount;
+            return true;
+        }
+
+        bool exact_key_match = pos < found.keyCount && compare_(found.keys[pos], key) == 0;
+        auto target_entry = exact_key_match || pos == 0 ? pos : pos - 1;
+        index_t target_child = found.children[target_entry];
+        if (!EraseFrom(target_child, key)) {
+            return false;
+        }
+
+        // Keep separator equal to the child's smallest key
+        const Node& child = nodes_[target_child];
+        if (child.keyCount > 0 && compare_(nodes_[node_index].keys[target_entry], child.keys[0]) != 0) {
+            WriteNode(node_index).keys[target_entry] = child.keys[0];
+        }
+        Rebalance(node_index, target_entry);
+        return true;
+    }
+
+    /**
+     * @brief Number of nodes a level of entries is spread over by Compact:
+     * as few as fill allows, without leaving nodes below min_fill.
+     */
+    static size_t LevelNodes(size_t entries, uint32_t fill, uint32_t min_fill) {
+        size_t nodes = (entries + fill - 1) / fill;
+        if (nodes > 1 && entries / nodes < min_fill) {
+            nodes = entries / min_fill;
+        }
+        return std::max<size_t>(nodes, 1);
+    }
+
+    /**
+     * @brief Fewest entries a non-root node may hold. Internal nodes keep at
+     * least two children, so no leaf is ever left empty.
+     */
+    static constexpr uint32_t MinFill(bool is_leaf) { return is_leaf ? N / 2 : std::max<uint32_t>((N - 1) / 2, 2); }
+
+    /**
+     * @brief Restores the minimum fill of a node's child after an erasure, by
+     * borrowing an entry from an adjacent sibling or merging with it.
+     *
+     * @param parent_index Index of parent node
+     * @param pos Position of the child within the parent's entries
+     */
+    void Rebalance(index_t parent_index, uint32_t pos) {
+        const Node& child = nodes_[nodes_[parent_index].children[pos]];
+        uint32_t min_fill = MinFill(child.isLeaf);
+        if (child.keyCount >= min_fill || nodes_[parent_index].keyCount < 2) {
+            return;
+        }
+
+        // Pair the child with its left sibling if it has one
+        Node& parent = WriteNode(parent_index);
+        uint32_t left_pos = pos > 0 ? pos - 1 : pos;
+        Node& left = WriteNode(parent.children[left_pos]);
+        Node& right = WriteNode(parent.children[left_pos + 1]);
+
+        if (pos > 0 && left.keyCount > min_fill) {
+            // Borrow the left sibling's last entry
+            for (uint32_t i = right.keyCount; i > 0; --i) {
+                right.CopyEntry(i, right, i - 1);
+            }
+            right.CopyEntry(0, left, --left.keyCount);
+            ++right.keyCount;
+            parent.keys[pos] = right.keys[0];
+        } else if (pos == 0 && right.keyCount > min_fill) {
+            // Borrow the right sibling's first entry
+            left.CopyEntry(left.keyCount++, right, 0);
+            for (uint32_t i = 0; i + 1 < right.keyCount; ++i) {
+                right.CopyEntry(i, right, i + 1);
+            }
+            --right.keyCount;
+            parent.keys[1] = right.keys[0];
+        } else {
+            // Merge the right node into the left one, which has room as both
+            // are at most half full
+            for (uint32_t i = 0; i < right.keyCount; ++i) {
+                left.CopyEntry(left.keyCount + i, right, i);
+            }
+            left.keyCount += right.keyCount;
+            if (left.isLeaf) {
+                left.next = right.next;
+            }
+            index_t right_index = parent.children[left_pos + 1];
+            for (uint32_t i = left_pos + 1; i + 1 < parent.keyCount; ++i) {
+                parent.CopyEntry(i, parent, i + 1);
+            }
+            --parent.keyCount;
+            FreeNode(right_index);
+        }
+    }
+
+    /**
+     * @brief Node being filled on one level of a bulk load.
+     */
+    struct BulkLevel {
+        Node node;
+        index_t last{0};    // Last node written on this level
+        size_t written{0};  // Number of nodes written on this level
+    };
+
+    /**
+     * @brief Writes out the node being filled on a level and records it in
+     * the level above.
+     */
+    void BulkPushNode(core::Vector<BulkLevel>& levels, size_t level, uint32_t internal_fill) {
+        index_t index = AllocateNode(levels[level].node);
+        K key = levels[level].node.keys[0];
+        // Nodes written so far are unreachable until the root is stored, so
+        // are modified without marking
+        if (level == 0 && levels[level].written > 0) {
+            nodes_[levels[level].last].next = index;
+        }
+        levels[level].last = index;
+        ++levels[level].written;
+        levels[level].node.keyCount = 0;
+
+        if (level + 1 == levels.size()) {
+            levels.push_back(BulkLevel{.node = Node::Make(0)});
+        }
+        if (levels[level + 1].node.keyCount == internal_fill) {
+            BulkPushNode(levels, level + 1, internal_fill);
+        }
+        Node& parent = levels[level + 1].node;
+        parent.keys[parent.keyCount] = key;
+        parent.children[parent.keyCount++] = index;
+    }
+
+    /**
+     * @brief Writes out the partially filled nodes of a bulk load from the
+     * leaves up, placing the root at index 0.
+     */
+    void BulkFinish(core::Vector<BulkLevel>& levels, uint32_t internal_fill) {
+        for (size_t level = 0; level < levels.size(); ++level) {
+            Node& node = levels[level].node;
+            if (levels[level].written == 0) {
+                // Only node on its level is the root
+                if (!node.isLeaf && node.keyCount == 1) {
+                    index_t child = node.children[0];
+                    StoreNode(0, nodes_[child]);
+                    FreeNode(child);
+                } else {
+                    StoreNode(0, node);
+                }
+                return;
+            }
+
+            // Fold a short last node into its left sibling if it fits, or top
+            // it up from the sibling, whose entry in the level above keeps its
+            // first key
+            Node& sibling = nodes_[levels[level].last];
+            if (node.keyCount < MinFill(node.isLeaf)) {
+                uint32_t total = node.keyCount + sibling.keyCount;
+                if (total <= (node.isLeaf ? N : N - 1)) {
+                    for (uint32_t i = 0; i < node.keyCount; ++i) {
+                        sibling.CopyEntry(sibling.keyCount + i, node, i);
+                    }
+                    sibling.keyCount = total;
+                    continue;
+                }
+                uint32_t move = (total / 2) - node.keyCount;
+                for (uint32_t i = node.keyCount; i > 0; --i) {
+                    node.CopyEntry(i - 1 + move, node, i - 1);
+                }
+                for (uint32_t i = 0; i < move; ++i) {
+                    node.CopyEntry(i, sibling, sibling.keyCount - move + i);
+                }
+                node.keyCount += move;
+                sibling.keyCount -= move;
+            }
+            BulkPushNode(levels, level, internal_fill);
+        }
+    }
+
     /**
      * @brief Finds the location of a key in the map, if it exists.
      */
@@ -194,20 +1365,20 @@ private:
             }
             auto pos = FindPosition(node, key);
             if (node.isLeaf) {
-                if (compare_(node.entries[pos].key, key) == 0) {
+                if (pos < node.keyCount && compare_(node.keys[pos], key) == 0) {
                     return {FindResult{.node = node_index, .entry = pos}};
                 } else {
                     return core::nullopt;
                 }
             } else {
-                bool exact_key_match = pos < node.keyCount && compare_(node.entries[pos].key, key) == 0;
+                bool exact_key_match = pos < node.keyCount && compare_(node.keys[pos], key) == 0;
                 if (!exact_key_match) {
                     // Key should be found be in prior entry slot (if exists)
                     if (pos > 0) {
                         --pos;
                     }
                 }
-                node_index = node.entries[pos].childIndex;
+                node_index = node.children[pos];
             }
         }
         return core::nullopt;
@@ -222,17 +1393,17 @@ private:
      * @param kv KV to insert
      */
     void InsertKVAtPosition(index_t node_index, uint32_t pos, KV kv) {
-        Node& node = nodes_[node_index];
+        Node& node = WriteNode(node_index);
         assert(node.keyCount < N);
         assert(pos <= node.keyCount);
 
         // Shift entries right to make space
         for (uint32_t i = node.keyCount; i > pos; --i) {
-            node.entries[i] = node.entries[i - 1];
+            node.CopyEntry(i, node, i - 1);
         }
 
         // Made space to insert
-        node.entries[pos] = kv;
+        node.SetEntry(pos, kv);
         ++node.keyCount;
     }
 
@@ -244,7 +1415,7 @@ private:
      * @param kv KV to insert
      */
     void InsertKVWithSpace(index_t node_index, KV kv) {
-        Node& node = nodes_[node_index];
+        const Node& node = nodes_[node_index];
         assert(node.keyCount < N);
         auto pos = FindPosition(node, kv.key);
         InsertKVAtPosition(node_index, pos, kv);
@@ -265,7 +1436,7 @@ private:
         Node* node = &nodes_[node_index];
         if (node->isLeaf) {
             auto pos = FindPosition(*node, key);
-            if (pos < node->keyCount && compare_(node->entries[pos].key, key) == 0) {
+            if (pos < node->keyCount && compare_(node->keys[pos], key) == 0) {
                 // Key already exists
                 return {false, core::nullopt};
             }
@@ -287,28 +1458,32 @@ private:
             }
         } else {
             auto pos = FindPosition(*node, key);
-            auto target_entry = pos == 0 ? pos : pos - 1;
-            auto target_child = node->entries[target_entry].childIndex;
+            bool exact_key_match = pos < node->keyCount && compare_(node->keys[pos], key) == 0;
+            auto target_entry = exact_key_match || pos == 0 ? pos : pos - 1;
+            auto target_child = node->children[target_entry];
 
             auto result = InsertInto(target_child, key, value);
             if (!result.inserted) {
                 return {false, core::nullopt};
             }
 
-            if (!result.split) {
-                // No split occurred
-                return {true, core::nullopt};
-            }
-
             // Rebind address of node -- it may have changed due to memory
             // reallocation during call to InsertInto
             node = &nodes_[node_index];
 
-            // Ensure left-most key in child matches our first entry's key (only
+            // Ensure left-most key in child matches our entry's key (only
             // relevant when the insertion places the new key at the start of
-            // the child entry)
+            // the child entry). Erasure relies on separators being exact.
+            const K& first_key = nodes_[target_child].keys[0];
+            if (compare_(node->keys[target_entry], first_key) != 0) {
+                WriteNode(node_index).keys[target_entry] = first_key;
+            }
+
+            if (!result.split) {
+                // No split occurred
+                return {true, core::nullopt};
+            }
             assert(result.split->left == target_child);
-            node->entries[target_entry].key = nodes_[target_child].entries[0].key;
             // Insert new split child record
             InsertKVWithSpace(node_index, KV{.key = result.split->key, .childIndex = result.split->right});
 
@@ -329,29 +1504,27 @@ private:
      * @return Split Description of split
      */
     Split SplitLeaf(index_t node_index) {
-        Node& old_node = nodes_[node_index];
+        Node& old_node = WriteNode(node_index);
         assert(old_node.isLeaf);
         assert(old_node.keyCount == N);
 
-        Node new_node = Node{
-            .isLeaf = 1,  // Leaf -> Two leafs
-            .keyCount = N / 2,
-        };
+        Node new_node = Node::Make(1, N / 2, old_node.next);
 
         // Copy right half of entries from old node into new node
         for (uint32_t i = 0; i < N / 2; ++i) {
-            new_node.entries[i] = old_node.entries[N - (N / 2) + i];
+            new_node.CopyEntry(i, old_node, N - (N / 2) + i);
         }
 
         // Update old node
         old_node.keyCount -= N / 2;
 
-        // Add new node
-        nodes_.PushBack(new_node);
+        // Add new node, linked in after old node
+        auto new_index = AllocateNode(new_node);
+        WriteNode(node_index).next = new_index;
         return Split{
             .left = node_index,
-            .right = static_cast<index_t>(nodes_.Size() - 1),
-            .key = new_node.entries[0].key,
+            .right = new_index,
+            .key = new_node.keys[0],
         };
     }
 
@@ -362,35 +1535,33 @@ private:
      * @return Split Description of split
      */
     Split SplitInternal(index_t node_index) {
-        Node& old_node = nodes_[node_index];
+        Node& old_node = WriteNode(node_index);
         assert(!old_node.isLeaf);
         assert(old_node.keyCount <= N);
 
-        Node new_node = Node{
-            .isLeaf = 0,
-            .keyCount = N / 2,
-        };
+        Node new_node = Node::Make(0, N / 2);
 
         // Copy right half of entries from old node into new node
         for (uint32_t i = 0; i < N / 2; ++i) {
-            new_node.entries[i] = old_node.entries[old_node.keyCount - (N / 2) + i];
+            new_node.CopyEntry(i, old_node, old_node.keyCount - (N / 2) + i);
         }
 
         // Update old node
         old_node.keyCount -= N / 2;
 
         // Add new node
-        nodes_.PushBack(new_node);
         return Split{
             .left = node_index,
-            .right = static_cast<index_t>(nodes_.Size() - 1),
-            .key = new_node.entries[0].key,
+            .right = AllocateNode(new_node),
+            .key = new_node.keys[0],
         };
     }
 
     /**
-     * @brief Finds the insertion position within a node's entries using binary
-     * search.
+     * @brief Finds the insertion position within a node's entries. Integer
+     * keys in natural order are located by counting smaller keys with SIMD
+     * compares, avoiding a mispredicted branch per probe; other keys use
+     * binary search.
      *
      * @tparam ComparableKey Search key type
      * @param node Node to search within
@@ -400,12 +1571,16 @@ private:
     template<typename ComparableKey>
         requires TotalOrderComparator<Compare, K, ComparableKey>
     uint32_t FindPosition(const Node& node, const ComparableKey& key) const {
+        if constexpr (VectorSearchable<ComparableKey>) {
+            return internal::CountLess(node.keys.Data(), node.keyCount, key);
+        }
+
         uint32_t left = 0;
         uint32_t right = node.keyCount;
 
         while (left < right) {
             uint32_t mid = left + ((right - left) / 2);
-            if (compare_(node.entries[mid].key, key) < 0) {
+            if (compare_(node.keys[mid], key) < 0) {
                 left = mid + 1;
             } else {
                 right = mid;
@@ -414,8 +1589,33 @@ private:
         return left;
     }
 
+    static constexpr size_t SpinsBeforeYield = 64;
+
+    // Version of the Node and Metadata layout, recorded in the node file.
+    // Bump it whenever either changes, so old files are refused at open.
+    // Maps written before version 1 used a different node layout and are not
+    // converted; rebuild them, e.g. with BulkLoad from the original data.
+    static constexpr uint32_t NodeLayoutVersion = 1;
+
+    static VectorFileOptions NodeFileOptions(VectorFileOptions options) {
+        options.layoutVersion = NodeLayoutVersion;
+        return options;
+    }
+
+    // Lookups descending together in FindMany
+    static constexpr size_t FindManyGroup = 16;
+
+    // Bytes of a node read when searching it: header and keys, within reason
+    static constexpr size_t SearchBytes = std::min<size_t>(offsetof(Node, keys) + sizeof(Node::keys), 1024);
+
     CustomVectorFile<Node, Metadata> nodes_;
     Compare compare_;
+
+    std::string path_;
+    VectorFileOptions options_;
+
+    core::Vector<index_t> written_;  // Nodes marked by the current write
+    uint32_t write_depth_{0};        // Nesting of WriteScopes
 };
 
 }  // namespace core
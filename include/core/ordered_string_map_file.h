@@ -0,0 +1,717 @@
+#ifndef CORE_ORDERED_STRING_MAP_FILE_H
+#define CORE_ORDERED_STRING_MAP_FILE_H
+
+#include "core/string.h"
+#include "core/string_view.h"
+#include "core/vector.h"
+#include "core/vector_file.h"
+
+#include <algorithm>
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+
+namespace core {
+
+/**
+ * @brief OrderedStringMapFile is a B+ tree keyed by variable-length strings,
+ * backed by a memory-mapped file.
+ *
+ * Each node is a fixed-size slotted page. A slot array grows up from the start
+ * of the page, and key bytes with their value or child index grow down from
+ * the end. The longest prefix shared by every key in a node is stored once,
+ * and only the remainder of each key is kept, so nodes of similar keys (URLs
+ * under one host, terms with a common stem) hold many more entries than
+ * fixed-width padded keys would.
+ *
+ * Keys are ordered bytewise as by StringView::Compare, rather than by a
+ * TotalOrderComparator as in OrderedMapFile: prefix compression relies on
+ * keys sharing a prefix being adjacent. Lookups take a StringView, so String,
+ * StringView and C strings all work without copying.
+ *
+ * The first slot of an internal node holds no key; its child covers every key
+ * below the node's second key, so keys smaller than any seen before need no
+ * separator to be lowered.
+ *
+ * @tparam V Value type
+ * @tparam NodeBytes Size of each node, at most 64KiB
+ */
+template<typename V, size_t NodeBytes = 4096>
+    requires std::is_trivially_copyable_v<V>
+class OrderedStringMapFile {
+    using index_t = uint32_t;
+
+    struct Metadata {
+        uint32_t size;
+    };
+
+    struct Slot {
+        uint16_t offset;  // Offset of entry's payload in node data
+        uint16_t size;    // Length of key after the node prefix
+    };
+
+    struct Node {
+        uint16_t isLeaf;
+        uint16_t keyCount;
+        uint16_t prefixSize;  // Length of shared prefix, stored at end of data
+        uint16_t heapStart;   // Offset of lowest used byte of entry heap
+        index_t next;         // Next leaf in key order; 0 if none
+        uint32_t reserved;
+        alignas(8) char data[NodeBytes - 16];
+    };
+
+    static constexpr size_t DataSize = sizeof(Node::data);
+    static constexpr size_t PayloadAlign = std::max(alignof(V), alignof(index_t));
+    static constexpr size_t MaxPayloadSize = std::max(sizeof(V), sizeof(index_t));
+
+    static_assert(sizeof(Node) == NodeBytes, "node header must not be padded");
+    static_assert(NodeBytes <= 65536, "slot offsets are 16 bits");
+    static_assert(PayloadAlign <= 8, "values must be at most 8-byte aligned");
+
+    /**
+     * @brief Decoded entry, used when a node must be rewritten.
+     */
+    struct Entry {
+        core::String key;
+        alignas(PayloadAlign) char payload[MaxPayloadSize]{};
+    };
+
+    struct SearchResult {
+        uint32_t pos;
+        bool exact;
+    };
+
+    struct InsertionResult {
+        bool inserted;
+        bool split;
+        index_t right;     // New right node, if split
+        core::String key;  // First key of right node, if split
+    };
+
+public:
+    /**
+     * @brief Longest key that may be stored. Bounds the size of an entry so
+     * that any node split leaves both halves within a node.
+     */
+    static constexpr size_t MaxKeySize = (DataSize / 4) - sizeof(Slot) - MaxPayloadSize - PayloadAlign;
+
+    static_assert(NodeBytes >= 256, "nodes must hold several keys");
+
+    /**
+     * @brief Key-value pair as seen through an Iterator. The key view points
+     * into the iterator and is only valid until it is advanced or destroyed;
+     * the value pointer is invalidated by insertion.
+     */
+    struct ConstPair {
+        StringView key;
+        const V* value;
+    };
+
+    /**
+     * @brief Forward iterator over pairs in key order. Keys are rebuilt from
+     * their node prefix and suffix into a buffer held by the iterator.
+     */
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = ConstPair;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = ConstPair;
+
+        Iterator() = default;
+
+        ConstPair operator*() const {
+            const Node& leaf = map_->nodes_[node_];
+            return ConstPair{
+                .key = StringView{key_, keySize_},
+                .value = reinterpret_cast<const V*>(leaf.data + GetSlot(leaf, pos_).offset),
+            };
+        }
+
+        Iterator& operator++() {
+            const Node& leaf = map_->nodes_[node_];
+            if (++pos_ < leaf.keyCount) {
+                LoadSuffix(leaf);
+            } else {
+                Seek(leaf.next == 0 ? NoNode : leaf.next, 0);
+            }
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const Iterator& other) const { return node_ == other.node_ && pos_ == other.pos_; }
+
+    private:
+        friend class OrderedStringMapFile;
+
+        Iterator(const OrderedStringMapFile* map, index_t node, uint32_t pos) : map_(map) { Seek(node, pos); }
+
+        void Seek(index_t node, uint32_t pos) {
+            node_ = node;
+            pos_ = pos;
+            if (node_ == NoNode) {
+                pos_ = 0;
+                return;
+            }
+            const Node& leaf = map_->nodes_[node_];
+            std::memcpy(key_, Prefix(leaf).Data(), leaf.prefixSize);
+            LoadSuffix(leaf);
+        }
+
+        void LoadSuffix(const Node& leaf) {
+            StringView suffix = Suffix(leaf, pos_);
+            std::memcpy(key_ + leaf.prefixSize, suffix.Data(), suffix.Size());
+            keySize_ = leaf.prefixSize + suffix.Size();
+        }
+
+        const OrderedStringMapFile* map_{nullptr};
+        index_t node_{NoNode};
+        uint32_t pos_{0};
+        size_t keySize_{0};
+        char key_[MaxKeySize];
+    };
+
+    /**
+     * @brief Half-open range of pairs, usable in range-based for loops.
+     */
+    struct PairRange {
+        Iterator first;
+        Iterator last;
+
+        Iterator begin() const { return first; }
+        Iterator end() const { return last; }
+    };
+
+    /**
+     * @brief Creates or opens a OrderedStringMapFile at the given path.
+     *
+     * @param path Path of backing file
+     * @param options Options for the backing node file. A read-only map must
+     * already exist and rejects insertions; open it through ReadOnlyFile. The
+     * layout version is set by the map, so files with another node layout are
+     * refused.
+     */
+    OrderedStringMapFile(const char* path, VectorFileOptions options = {}) : nodes_(path, NodeFileOptions(options)) {
+        if (nodes_.Empty() && !nodes_.ReadOnly()) {
+            nodes_.PushBack(EmptyNode(true));
+        }
+    }
+
+    size_t Size() const { return nodes_.CustomData()->size; }
+    bool Empty() const { return Size() == 0; }
+
+    /**
+     * @brief Attempts to insert a key-value pair into the map.
+     *
+     * @param key Key to insert, at most MaxKeySize bytes
+     * @param value Value to insert
+     * @return true Insertion occurred
+     * @return false Insertion did not occur -- key already present
+     */
+    bool Insert(StringView key, const V& value) {
+        if (nodes_.ReadOnly()) {
+            throw std::runtime_error("ordered string map file is read-only");
+        }
+        if (key.Size() > MaxKeySize) {
+            throw std::length_error("key too long for ordered string map file");
+        }
+
+        auto result = InsertInto(0, key, value);
+        if (!result.inserted) {
+            return false;
+        }
+
+        if (result.split) {
+            // Root node was split; move its left half out so the new root can
+            // stay at index 0
+            core::Vector<Entry> entries;
+            entries.push_back(Entry{});
+            entries.push_back(Entry{.key = std::move(result.key)});
+            index_t left = AllocateNode(nodes_[0]);
+            std::memcpy(entries[0].payload, &left, sizeof(index_t));
+            std::memcpy(entries[1].payload, &result.right, sizeof(index_t));
+            nodes_[0] = Encode(false, 0, entries, 0, entries.size());
+        }
+
+        ++nodes_.CustomData()->size;
+        return true;
+    }
+
+    /**
+     * @brief Inserts a key-value pair, or assigns the value if the key is
+     * already present.
+     *
+     * @param key Key to insert, at most MaxKeySize bytes
+     * @param value Value to insert or assign
+     * @return true Insertion occurred
+     * @return false Existing value was assigned
+     */
+    bool InsertOrAssign(StringView key, const V& value) {
+        if (nodes_.ReadOnly()) {
+            throw std::runtime_error("ordered string map file is read-only");
+        }
+        if (V* found = Find(key)) {
+            *found = value;
+            return false;
+        }
+        return Insert(key, value);
+    }
+
+    /**
+     * @brief Finds the value of a key in the map.
+     *
+     * @param key Key to look up
+     * @return V* Pointer to the stored value, or nullptr if key is not in map.
+     * Invalidated by insertion.
+     */
+    V* Find(StringView key) {
+        return const_cast<V*>(static_cast<const OrderedStringMapFile*>(this)->Find(key));
+    }
+
+    /**
+     * @brief Finds the value of a key in the map.
+     *
+     * @param key Key to look up
+     * @return const V* Pointer to the stored value, or nullptr if key is not
+     * in map.
+     */
+    const V* Find(StringView key) const {
+        if (Empty()) {
+            return nullptr;
+        }
+        const Node& leaf = nodes_[FindLeaf(key)];
+        auto found = FindPosition(leaf, key);
+        if (!found.exact) {
+            return nullptr;
+        }
+        return reinterpret_cast<const V*>(leaf.data + GetSlot(leaf, found.pos).offset);
+    }
+
+    /**
+     * @brief Checks whether a key is present in the map.
+     *
+     * @param key Key to look up
+     * @return Whether the key is in the map.
+     */
+    bool Contains(StringView key) const { return Find(key) != nullptr; }
+
+    Iterator begin() const {
+        if (Empty()) {
+            return end();
+        }
+        index_t node_index = 0;
+        while (!nodes_[node_index].isLeaf) {
+            node_index = ChildAt(nodes_[node_index], 0);
+        }
+        return nodes_[node_index].keyCount > 0 ? Iterator{this, node_index, 0} : end();
+    }
+
+    Iterator end() const { return Iterator{this, NoNode, 0}; }
+
+    /**
+     * @brief Finds the first pair whose key is not less than the given key.
+     *
+     * @param key Key to search for
+     * @return Iterator Position of pair, or end() if none
+     */
+    Iterator LowerBound(StringView key) const {
+        if (Empty()) {
+            return end();
+        }
+        index_t node_index = FindLeaf(key);
+        const Node& leaf = nodes_[node_index];
+        uint32_t pos = FindPosition(leaf, key).pos;
+        if (pos < leaf.keyCount) {
+            return Iterator{this, node_index, pos};
+        }
+        return leaf.next == 0 ? end() : Iterator{this, leaf.next, 0};
+    }
+
+    /**
+     * @brief Finds the first pair whose key is greater than the given key.
+     *
+     * @param key Key to search for
+     * @return Iterator Position of pair, or end() if none
+     */
+    Iterator UpperBound(StringView key) const {
+        Iterator it = LowerBound(key);
+        if (it != end() && (*it).key == key) {
+            ++it;
+        }
+        return it;
+    }
+
+    /**
+     * @brief Gets the pairs with keys in [lo, hi), in key order. A key prefix
+     * p selects its keys with lo = p and hi = p with its last byte
+     * incremented.
+     *
+     * @param lo Inclusive lower bound
+     * @param hi Exclusive upper bound
+     * @return PairRange Range of pairs
+     */
+    PairRange Range(StringView lo, StringView hi) const {
+        Iterator last = LowerBound(hi);
+        if (hi.Compare(lo) <= 0) {
+            // Empty range when hi <= lo
+            return {last, last};
+        }
+        return {LowerBound(lo), last};
+    }
+
+    /**
+     * @brief Calls fn(key, value) for every pair in key order. The key view is
+     * only valid for the duration of the call.
+     *
+     * @param fn Callable invoked as fn(StringView key, const V& value)
+     */
+    template<typename F>
+        requires std::invocable<F&, StringView, const V&>
+    void ForEach(F fn) const {
+        if (Empty()) {
+            return;
+        }
+        index_t node_index = 0;
+        while (!nodes_[node_index].isLeaf) {
+            node_index = ChildAt(nodes_[node_index], 0);
+        }
+
+        char buffer[MaxKeySize];
+        while (true) {
+            const Node& leaf = nodes_[node_index];
+            std::memcpy(buffer, Prefix(leaf).Data(), leaf.prefixSize);
+            for (uint32_t i = 0; i < leaf.keyCount; ++i) {
+                StringView suffix = Suffix(leaf, i);
+                std::memcpy(buffer + leaf.prefixSize, suffix.Data(), suffix.Size());
+                fn(StringView{buffer, leaf.prefixSize + suffix.Size()},
+                   *reinterpret_cast<const V*>(leaf.data + GetSlot(leaf, i).offset));
+            }
+            if (leaf.next == 0) {
+                return;
+            }
+            node_index = leaf.next;
+        }
+    }
+
+private:
+    static constexpr index_t NoNode = UINT32_MAX;
+
+    // Version of the Node and Metadata layout, recorded in the node file.
+    // Bump it whenever either changes, so old files are refused at open.
+    static constexpr uint32_t NodeLayoutVersion = 1;
+
+    static VectorFileOptions NodeFileOptions(VectorFileOptions options) {
+        options.layoutVersion = NodeLayoutVersion;
+        return options;
+    }
+
+    static constexpr size_t AlignDown(size_t n) { return n & ~(PayloadAlign - 1); }
+    static constexpr size_t AlignUp(size_t n) { return AlignDown(n + PayloadAlign - 1); }
+    static constexpr size_t PayloadSize(bool is_leaf) { return is_leaf ? sizeof(V) : sizeof(index_t); }
+
+    static Node EmptyNode(bool is_leaf) {
+        Node node{};
+        node.isLeaf = is_leaf;
+        node.keyCount = 0;
+        node.prefixSize = 0;
+        node.heapStart = AlignDown(DataSize);
+        node.next = 0;
+        node.reserved = 0;
+        return node;
+    }
+
+    static Slot GetSlot(const Node& node, uint32_t pos) {
+        Slot slot;
+        std::memcpy(&slot, node.data + (pos * sizeof(Slot)), sizeof(Slot));
+        return slot;
+    }
+
+    static void SetSlot(Node& node, uint32_t pos, Slot slot) {
+        std::memcpy(node.data + (pos * sizeof(Slot)), &slot, sizeof(Slot));
+    }
+
+    static StringView Prefix(const Node& node) { return {node.data + DataSize - node.prefixSize, node.prefixSize}; }
+
+    static StringView Suffix(const Node& node, uint32_t pos) {
+        Slot slot = GetSlot(node, pos);
+        return {node.data + slot.offset + PayloadSize(node.isLeaf), slot.size};
+    }
+
+    static core::String Key(const Node& node, uint32_t pos) {
+        core::String key{Prefix(node)};
+        key.Append(Suffix(node, pos));
+        return key;
+    }
+
+    static index_t ChildAt(const Node& node, uint32_t pos) {
+        index_t child;
+        std::memcpy(&child, node.data + GetSlot(node, pos).offset, sizeof(index_t));
+        return child;
+    }
+
+    /**
+     * @brief Position of the first entry with a key. Slot 0 of an internal
+     * node stands for every key below the node's second key, so stores none.
+     */
+    static constexpr uint32_t FirstKeyed(bool is_leaf) { return is_leaf ? 0 : 1; }
+
+    /**
+     * @brief Finds where a key belongs within a node. The prefix is compared
+     * once; only keys that share it are compared against remainders.
+     */
+    static SearchResult FindPosition(const Node& node, StringView key) {
+        uint32_t first = FirstKeyed(node.isLeaf);
+        StringView prefix = Prefix(node);
+        if (!key.StartsWith(prefix)) {
+            // Key sorts entirely before or after this node's keys
+            return {key.Compare(prefix) < 0 ? first : node.keyCount, false};
+        }
+        key.RemovePrefix(prefix.Size());
+
+        uint32_t left = first;
+        uint32_t right = node.keyCount;
+        while (left < right) {
+            uint32_t mid = left + ((right - left) / 2);
+            if (Suffix(node, mid).Compare(key) < 0) {
+                left = mid + 1;
+            } else {
+                right = mid;
+            }
+        }
+        return {left, left < node.keyCount && Suffix(node, left) == key};
+    }
+
+    /**
+     * @brief Picks the child to descend into: the last one whose key is not
+     * greater than the searched key, or the keyless first child.
+     */
+    static uint32_t ChildPosition(SearchResult found) { return found.exact ? found.pos : found.pos - 1; }
+
+    /**
+     * @brief Finds the leaf a key belongs in.
+     */
+    index_t FindLeaf(StringView key) const {
+        index_t node_index = 0;
+        while (!nodes_[node_index].isLeaf) {
+            const Node& node = nodes_[node_index];
+            node_index = ChildAt(node, ChildPosition(FindPosition(node, key)));
+        }
+        return node_index;
+    }
+
+    /**
+     * @brief Decodes the entries of a node, with a new one inserted at pos.
+     */
+    static core::Vector<Entry> Decode(const Node& node, uint32_t pos, StringView key, const void* payload) {
+        core::Vector<Entry> entries;
+        entries.reserve(node.keyCount + 1);
+        size_t payload_size = PayloadSize(node.isLeaf);
+        for (uint32_t i = 0; i <= node.keyCount; ++i) {
+            if (i == pos) {
+                entries.push_back(Entry{.key = core::String{key}});
+                std::memcpy(entries.back().payload, payload, payload_size);
+            }
+            if (i < node.keyCount) {
+                entries.push_back(Entry{.key = i < FirstKeyed(node.isLeaf) ? core::String{} : Key(node, i)});
+                std::memcpy(entries.back().payload, node.data + GetSlot(node, i).offset, payload_size);
+            }
+        }
+        return entries;
+    }
+
+    static size_t CommonPrefix(StringView a, StringView b) {
+        size_t n = std::min(a.Size(), b.Size());
+        size_t i = 0;
+        while (i < n && a[i] == b[i]) {
+            ++i;
+        }
+        return i;
+    }
+
+    /**
+     * @brief Length of the prefix shared by the keys of entries [first, last).
+     */
+    static size_t SharedPrefix(const core::Vector<Entry>& entries, size_t first, size_t last) {
+        // Sorted, so the first and last keys share the shortest prefix
+        return first < last ? CommonPrefix(entries[first].key, entries[last - 1].key) : 0;
+    }
+
+    /**
+     * @brief Bytes entries [first, last) take when encoded into one node.
+     */
+    static size_t EncodedBytes(const core::Vector<Entry>& entries, size_t first, size_t last, bool is_leaf) {
+        size_t keyed = first + FirstKeyed(is_leaf);
+        size_t prefix = SharedPrefix(entries, keyed, last);
+        size_t bytes = AlignUp(prefix);
+        for (size_t i = first; i < last; ++i) {
+            size_t suffix = i < keyed ? 0 : entries[i].key.Size() - prefix;
+            bytes += sizeof(Slot) + AlignUp(PayloadSize(is_leaf) + suffix);
+        }
+        return bytes;
+    }
+
+    /**
+     * @brief Chooses where to split entries that overflow a node, balancing
+     * the encoded size of the halves. Widening a range can only shorten its
+     * shared prefix, so the left half grows and the right half shrinks as the
+     * split moves right; the split is taken where they cross.
+     *
+     * A key that does not share a node's prefix sorts before or after all of
+     * its keys, so splitting it off alone always fits; otherwise every key
+     * shares the prefix and halving by size fits.
+     */
+    static size_t SplitPoint(const core::Vector<Entry>& entries, bool is_leaf) {
+        size_t count = entries.size();
+        auto larger_half = [&](size_t mid) {
+            return std::max(EncodedBytes(entries, 0, mid, is_leaf), EncodedBytes(entries, mid, count, is_leaf));
+        };
+
+        size_t lo = 1;
+        size_t hi = count - 1;
+        while (lo < hi) {
+            size_t mid = lo + ((hi - lo) / 2);
+            if (EncodedBytes(entries, 0, mid, is_leaf) < EncodedBytes(entries, mid, count, is_leaf)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+
+        // Alignment padding makes sizes only nearly monotone; check around
+        // the crossing
+        size_t best = lo;
+        for (size_t mid = std::max<size_t>(lo, 3) - 2; mid <= std::min(lo + 2, count - 1); ++mid) {
+            if (larger_half(mid) < larger_half(best)) {
+                best = mid;
+            }
+        }
+        return best;
+    }
+
+    /**
+     * @brief Builds a node from sorted entries [first, last), which must fit.
+     */
+    static Node Encode(bool is_leaf, index_t next, const core::Vector<Entry>& entries, size_t first, size_t last) {
+        Node node = EmptyNode(is_leaf);
+        node.next = next;
+
+        size_t keyed = first + FirstKeyed(is_leaf);
+        size_t prefix_size = SharedPrefix(entries, keyed, last);
+        node.prefixSize = prefix_size;
+        if (prefix_size > 0) {
+            std::memcpy(node.data + DataSize - prefix_size, entries[keyed].key.Cstr(), prefix_size);
+        }
+        node.heapStart = AlignDown(DataSize - prefix_size);
+
+        for (size_t i = first; i < last; ++i) {
+            StringView suffix = entries[i].key;
+            suffix.RemovePrefix(i < keyed ? suffix.Size() : prefix_size);
+            [[maybe_unused]] bool stored =
+                StoreEntry(node, static_cast<uint32_t>(i - first), suffix, entries[i].payload);
+            assert(stored);
+        }
+        return node;
+    }
+
+    /**
+     * @brief Adds an entry at pos using the node's free space, if there is
+     * enough. The key must share the node's prefix, and suffix excludes it.
+     */
+    static bool StoreEntry(Node& node, uint32_t pos, StringView suffix, const void* payload) {
+        size_t payload_size = PayloadSize(node.isLeaf);
+        size_t bytes = payload_size + suffix.Size();
+        size_t slots_end = (node.keyCount + 1) * sizeof(Slot);
+        if (node.heapStart < bytes + slots_end || AlignDown(node.heapStart - bytes) < slots_end) {
+            return false;
+        }
+
+        size_t start = AlignDown(node.heapStart - bytes);
+        std::memcpy(node.data + start, payload, payload_size);
+        std::memcpy(node.data + start + payload_size, suffix.Data(), suffix.Size());
+        std::memmove(node.data + ((pos + 1) * sizeof(Slot)),
+                     node.data + (pos * sizeof(Slot)),
+                     (node.keyCount - pos) * sizeof(Slot));
+        SetSlot(node, pos, Slot{static_cast<uint16_t>(start), static_cast<uint16_t>(suffix.Size())});
+        node.heapStart = start;
+        ++node.keyCount;
+        return true;
+    }
+
+    /**
+     * @brief Stores a node at the end of the file. Takes the node by value, as
+     * growing the file may move the mapping.
+     */
+    index_t AllocateNode(Node node) {
+        nodes_.PushBack(node);
+        return static_cast<index_t>(nodes_.Size() - 1);
+    }
+
+    /**
+     * @brief Inserts an entry into a node at pos. Done in place when the key
+     * shares the node's prefix and fits in its free space; otherwise the node
+     * is rewritten with a recomputed prefix, splitting in two by bytes if the
+     * entries no longer fit.
+     */
+    InsertionResult InsertEntry(index_t node_index, uint32_t pos, StringView key, const void* payload) {
+        Node& node = nodes_[node_index];
+        StringView prefix = Prefix(node);
+        if (key.StartsWith(prefix) && StoreEntry(node, pos, key.Substr(prefix.Size()), payload)) {
+            return {true, false, 0, {}};
+        }
+
+        bool is_leaf = node.isLeaf;
+        index_t next = node.next;
+        core::Vector<Entry> entries = Decode(node, pos, key, payload);
+        if (EncodedBytes(entries, 0, entries.size(), is_leaf) <= DataSize) {
+            nodes_[node_index] = Encode(is_leaf, next, entries, 0, entries.size());
+            return {true, false, 0, {}};
+        }
+
+        size_t mid = SplitPoint(entries, is_leaf);
+        index_t right = AllocateNode(Encode(is_leaf, next, entries, mid, entries.size()));
+        nodes_[node_index] = Encode(is_leaf, is_leaf ? right : 0, entries, 0, mid);
+        // In internal nodes the split key moves up, leaving the right node's
+        // first slot keyless
+        return {true, true, right, std::move(entries[mid].key)};
+    }
+
+    /**
+     * @brief Inserts a key-value pair into the subtree rooted at a node. If
+     * the node splits, the result describes its new right sibling.
+     */
+    InsertionResult InsertInto(index_t node_index, StringView key, const V& value) {
+        const Node& node = nodes_[node_index];
+        auto found = FindPosition(node, key);
+        if (node.isLeaf) {
+            if (found.exact) {
+                return {false, false, 0, {}};
+            }
+            return InsertEntry(node_index, found.pos, key, &value);
+        }
+
+        uint32_t target = ChildPosition(found);
+        auto result = InsertInto(ChildAt(node, target), key, value);
+        if (!result.split) {
+            return result;
+        }
+        // New right child goes directly after the child that split
+        return InsertEntry(node_index, target + 1, result.key, &result.right);
+    }
+
+    CustomVectorFile<Node, Metadata> nodes_;
+};
+
+}  // namespace core
+
+#endif
@@ -0,0 +1,363 @@
+#ifndef CORE_PARALLEL_SCAN_H
+#define CORE_PARALLEL_SCAN_H
+
+#include "core/mem_map_file.h"
+#include "core/span.h"
+#include "core/vector.h"
+#include "core/vector_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <type_traits>
+#include <unistd.h>
+#include <utility>
+
+#if __has_include(<omp.h>)
+#include <omp.h>
+#endif
+
+namespace core {
+
+struct ScanOptions {
+    /**
+     * @brief Bytes per unit of work, rounded up to whole pages. Chunk
+     * boundaries fall on page boundaries, so no two threads fault in or
+     * release the same page.
+     */
+    size_t chunkBytes{4 * 1024 * 1024};
+
+    /**
+     * @brief How many chunks past each claimed chunk to madvise
+     * MADV_WILLNEED, so readahead overlaps with processing.
+     */
+    size_t prefetchChunks{4};
+
+    /**
+     * @brief Drop each chunk's pages from the page cache once processed,
+     * paging them out of the mapping with MADV_PAGEOUT and then
+     * posix_fadvise POSIX_FADV_DONTNEED on the file. Meant for one-pass scans
+     * of files larger than memory, so the scan drops its own pages instead of
+     * the page cache evicting everyone else's. The data in the file is kept.
+     * Does nothing where the system headers lack MADV_PAGEOUT, since fadvise
+     * alone skips pages that are still mapped. Only the overloads taking a
+     * VectorFile or MemMapFile support it; the Span overloads throw
+     * std::invalid_argument, having no file to advise.
+     */
+    bool releaseConsumed{false};
+
+    /**
+     * @brief Number of threads, or 0 for the OpenMP default.
+     */
+    int threads{0};
+};
+
+namespace internal {
+
+/**
+ * @brief Splits a mapped array into page-aligned chunks. An element belongs
+ * to the chunk containing its first byte.
+ */
+class ScanPlan {
+public:
+    /**
+     * @param fd Descriptor of the file the array is mapped from, or -1
+     * @param offset File offset of the array's first byte
+     */
+    ScanPlan(const void* data,
+             size_t count,
+             size_t element_size,
+             const ScanOptions& options,
+             int fd = -1,
+             off_t offset = 0)
+        : options_(options),
+          base_(static_cast<const char*>(data)),
+          count_(count),
+          element_size_(element_size),
+          chunk_bytes_(std::max(RoundUp(options.chunkBytes), PageSize)),
+          fd_(fd),
+          offset_(offset) {
+        if (options_.releaseConsumed && fd_ == -1) {
+            throw std::invalid_argument("releasing consumed pages needs a file-backed scan");
+        }
+        aligned_base_ = base_ - (reinterpret_cast<uintptr_t>(base_) % PageSize);
+        size_t span = (base_ + (count_ * element_size_)) - aligned_base_;
+        chunk_count_ = count_ == 0 ? 0 : (span + chunk_bytes_ - 1) / chunk_bytes_;
+
+        for (size_t chunk = 0; chunk < options_.prefetchChunks && chunk < chunk_count_; ++chunk) {
+            Prefetch(chunk);
+        }
+    }
+
+    size_t ChunkCount() const { return chunk_count_; }
+
+    int Threads() const {
+#ifdef _OPENMP
+        return options_.threads > 0 ? options_.threads : omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+    /**
+     * @brief Index of the first element that begins in the chunk.
+     */
+    size_t FirstIndex(size_t chunk) const {
+        const char* start = aligned_base_ + (chunk * chunk_bytes_);
+        if (start <= base_) {
+            return 0;
+        }
+        size_t offset = start - base_;
+        size_t index = (offset + element_size_ - 1) / element_size_;
+        return std::min(index, count_);
+    }
+
+    void BeginChunk(size_t chunk) const {
+        if (options_.prefetchChunks > 0 && chunk + options_.prefetchChunks < chunk_count_) {
+            Prefetch(chunk + options_.prefetchChunks);
+        }
+    }
+
+    void EndChunk(size_t chunk) const {
+        if (options_.releaseConsumed) {
+            Release(chunk);
+        }
+    }
+
+private:
+    static size_t RoundUp(size_t n) { return (n + PageSize - 1) & ~(PageSize - 1); }
+
+    uintptr_t ChunkBegin(size_t chunk) const {
+        return reinterpret_cast<uintptr_t>(aligned_base_ + (chunk * chunk_bytes_));
+    }
+
+    uintptr_t DataEnd() const { return reinterpret_cast<uintptr_t>(base_ + (count_ * element_size_)); }
+
+    void Prefetch(size_t chunk) const {
+        uintptr_t begin = ChunkBegin(chunk);
+        uintptr_t end = std::min(begin + chunk_bytes_, RoundUp(DataEnd()));
+        if (begin < end) {
+            // Advice is a hint; failures are harmless
+            madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+        }
+    }
+
+    /**
+     * @brief Drops the chunk's pages from the page cache. Pages shared with
+     * bytes outside the array are kept.
+     */
+    void Release(size_t chunk) const {
+        uintptr_t begin = std::max(ChunkBegin(chunk), RoundUp(reinterpret_cast<uintptr_t>(base_)));
+        uintptr_t end = std::min(ChunkBegin(chunk) + chunk_bytes_, DataEnd() & ~(PageSize - 1));
+        if (begin >= end) {
+            return;
+        }
+#ifdef MADV_PAGEOUT
+        // fadvise skips pages still mapped, so unmap them from this process
+        // first; both are hints and failures are harmless
+        madvise(reinterpret_cast<void*>(begin), end - begin, MADV_PAGEOUT);
+#if defined(_POSIX_ADVISORY_INFO) && _POSIX_ADVISORY_INFO > 0
+        off_t offset = offset_ + static_cast<off_t>(begin - reinterpret_cast<uintptr_t>(base_));
+        posix_fadvise(fd_, offset, static_cast<off_t>(end - begin), POSIX_FADV_DONTNEED);
+#endif
+#endif
+    }
+
+    ScanOptions options_;
+    const char* base_;
+    const char* aligned_base_;
+    size_t count_;
+    size_t element_size_;
+    size_t chunk_bytes_;
+    size_t chunk_count_;
+    int fd_;
+    off_t offset_;
+};
+
+template<typename T, typename F>
+void ParallelForEach(const ScanPlan& plan, const T* elements, F& fn) {
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(plan.Threads())
+    for (size_t chunk = 0; chunk < plan.ChunkCount(); ++chunk) {
+        if (failed.load(std::memory_order_relaxed)) {
+            continue;
+        }
+        plan.BeginChunk(chunk);
+        try {
+            size_t last = plan.FirstIndex(chunk + 1);
+            for (size_t i = plan.FirstIndex(chunk); i < last; ++i) {
+                fn(elements[i], i);
+            }
+        } catch (...) {
+#pragma omp critical(core_parallel_scan_error)
+            if (!failed.exchange(true)) {
+                error = std::current_exception();
+            }
+        }
+        plan.EndChunk(chunk);
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+template<typename T, typename R, typename Fold, typename Combine>
+R ParallelReduce(const ScanPlan& plan, const T* elements, R identity, Fold& fold, Combine& combine) {
+    core::Vector<R> partials(plan.ChunkCount(), identity);
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(plan.Threads())
+    for (size_t chunk = 0; chunk < plan.ChunkCount(); ++chunk) {
+        if (failed.load(std::memory_order_relaxed)) {
+            continue;
+        }
+        plan.BeginChunk(chunk);
+        try {
+            R acc = identity;
+            size_t last = plan.FirstIndex(chunk + 1);
+            for (size_t i = plan.FirstIndex(chunk); i < last; ++i) {
+                acc = fold(std::move(acc), elements[i]);
+            }
+            partials[chunk] = std::move(acc);
+        } catch (...) {
+#pragma omp critical(core_parallel_scan_error)
+            if (!failed.exchange(true)) {
+                error = std::current_exception();
+            }
+        }
+        plan.EndChunk(chunk);
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    R result = identity;
+    for (auto& partial : partials) {
+        result = combine(std::move(result), std::move(partial));
+    }
+    return result;
+}
+
+}  // namespace internal
+
+/**
+ * @brief Calls fn(value, index) for every element of a memory-mapped array,
+ * in parallel over page-aligned chunks. Calls for different chunks run
+ * concurrently, so fn must be safe to call from several threads. If any call
+ * throws, remaining chunks are skipped and the first exception is rethrown.
+ *
+ * @param data Elements to visit
+ * @param fn Callable invoked as fn(const T& value, size_t index)
+ * @param options Chunking and prefetch options
+ */
+template<typename T, typename F>
+    requires std::invocable<F&, const T&, size_t>
+void ParallelForEach(core::Span<const T> data, F fn, ScanOptions options = {}) {
+    internal::ScanPlan plan(data.Data(), data.Size(), sizeof(T), options);
+    internal::ParallelForEach(plan, data.Data(), fn);
+}
+
+/**
+ * @brief Folds every element of a memory-mapped array in parallel. Each chunk
+ * is folded from identity, and the per-chunk results are combined in chunk
+ * order, so combine need only be associative.
+ *
+ * @param data Elements to reduce
+ * @param identity Starting value for each chunk
+ * @param fold Callable invoked as fold(R acc, const T& value) -> R
+ * @param combine Callable invoked as combine(R left, R right) -> R
+ * @param options Chunking and prefetch options
+ * @return R Reduction of all elements
+ */
+template<typename T, typename R, typename Fold, typename Combine>
+    requires std::invocable<Fold&, R, const T&> && std::invocable<Combine&, R, R>
+R ParallelReduce(core::Span<const T> data, R identity, Fold fold, Combine combine, ScanOptions options = {}) {
+    internal::ScanPlan plan(data.Data(), data.Size(), sizeof(T), options);
+    return internal::ParallelReduce(plan, data.Data(), std::move(identity), fold, combine);
+}
+
+/**
+ * @brief Views a memory-mapped file as an array of T. Trailing bytes that do
+ * not fill a whole element are excluded.
+ */
+template<typename T>
+    requires std::is_trivially_copyable_v<T>
+core::Span<const T> ArrayView(const MemMapFile& file) {
+    return {reinterpret_cast<const T*>(file.data()), file.size() / sizeof(T)};
+}
+
+/**
+ * @brief ParallelForEach over a memory-mapped file viewed as an array of T,
+ * as by ArrayView. Supports ScanOptions::releaseConsumed.
+ */
+template<typename T, typename F>
+    requires std::is_trivially_copyable_v<T> && std::invocable<F&, const T&, size_t>
+void ParallelForEach(const MemMapFile& file, F fn, ScanOptions options = {}) {
+    auto data = ArrayView<T>(file);
+    internal::ScanPlan plan(data.Data(), data.Size(), sizeof(T), options, file.FileDescriptor());
+    internal::ParallelForEach(plan, data.Data(), fn);
+}
+
+/**
+ * @brief ParallelReduce over a memory-mapped file viewed as an array of T, as
+ * by ArrayView. Supports ScanOptions::releaseConsumed.
+ */
+template<typename T, typename R, typename Fold, typename Combine>
+    requires std::is_trivially_copyable_v<T> && std::invocable<Fold&, R, const T&> && std::invocable<Combine&, R, R>
+R ParallelReduce(const MemMapFile& file, R identity, Fold fold, Combine combine, ScanOptions options = {}) {
+    auto data = ArrayView<T>(file);
+    internal::ScanPlan plan(data.Data(), data.Size(), sizeof(T), options, file.FileDescriptor());
+    return internal::ParallelReduce(plan, data.Data(), std::move(identity), fold, combine);
+}
+
+/**
+ * @brief ParallelForEach over the elements of a VectorFile. Supports
+ * ScanOptions::releaseConsumed.
+ */
+template<typename T, typename CustomDataType, typename F>
+    requires std::invocable<F&, const T&, size_t>
+void ParallelForEach(const CustomVectorFile<T, CustomDataType>& file, F fn, ScanOptions options = {}) {
+    internal::ScanPlan plan(file.Data(),
+                          file.Size(),
+                          sizeof(T),
+                          options,
+                          file.FileDescriptor(),
+                          CustomVectorFile<T, CustomDataType>::HeaderSpace);
+    internal::ParallelForEach(plan, file.Data(), fn);
+}
+
+/**
+ * @brief ParallelReduce over the elements of a VectorFile. Supports
+ * ScanOptions::releaseConsumed.
+ */
+template<typename T, typename CustomDataType, typename R, typename Fold, typename Combine>
+    requires std::invocable<Fold&, R, const T&> && std::invocable<Combine&, R, R>
+R ParallelReduce(const CustomVectorFile<T, CustomDataType>& file,
+                 R identity,
+                 Fold fold,
+                 Combine combine,
+                 ScanOptions options = {}) {
+    internal::ScanPlan plan(file.Data(),
+                          file.Size(),
+                          sizeof(T),
+                          options,
+                          file.FileDescriptor(),
+                          CustomVectorFile<T, CustomDataType>::HeaderSpace);
+    return internal::ParallelReduce(plan, file.Data(), std::move(identity), fold, combine);
+}
+
+}  // namespace core
+
+#endif
@@ -0,0 +1,83 @@
+/**
+ * @file read_only_file.h
+ * @brief Read-only handle to a memory-mapped container
+ *
+ */
+
+#ifndef LIB_READ_ONLY_FILE_H
+#define LIB_READ_ONLY_FILE_H
+
+#include "core/vector_file.h"
+
+#include <concepts>
+#include <type_traits>
+#include <utility>
+
+namespace core {
+
+namespace internal {
+
+template<typename Arg>
+concept VectorFileOptionsArg = std::same_as<std::remove_cvref_t<Arg>, VectorFileOptions>;
+
+/**
+ * @brief Passes a constructor argument through unchanged, unless it is the
+ * options, which get readOnly set.
+ */
+template<typename Arg>
+decltype(auto) ForceReadOnly(Arg&& arg) {
+    if constexpr (VectorFileOptionsArg<Arg>) {
+        VectorFileOptions options = arg;
+        options.readOnly = true;
+        return options;
+    } else {
+        return std::forward<Arg>(arg);
+    }
+}
+
+}  // namespace internal
+
+/**
+ * @brief A memory-mapped container opened with VectorFileOptions::readOnly:
+ * a VectorFile, OrderedMapFile, OrderedStringMapFile or any other container
+ * taking VectorFileOptions. The container is only reachable through a const
+ * reference, so writing to the PROT_READ mapping is a compile error rather
+ * than a SIGSEGV, and the accessors themselves stay unchecked.
+ *
+ * @tparam File Container type
+ */
+template<typename File>
+class ReadOnlyFile {
+public:
+    /**
+     * @brief Opens an existing file read-only. The arguments after the path
+     * are passed on to File's constructor, with readOnly set on the
+     * VectorFileOptions among them.
+     */
+    template<typename... Args>
+        requires(internal::VectorFileOptionsArg<Args> || ...)
+    explicit ReadOnlyFile(const char* path, Args&&... args)
+        : file_(path, internal::ForceReadOnly(std::forward<Args>(args))...) {}
+
+    /**
+     * @brief Opens an existing file read-only with otherwise default options.
+     * The arguments after the path are passed on to File's constructor.
+     */
+    template<typename... Args>
+        requires(!(internal::VectorFileOptionsArg<Args> || ...))
+    explicit ReadOnlyFile(const char* path, Args&&... args)
+        : file_(path, std::forward<Args>(args)..., VectorFileOptions{.readOnly = true}) {}
+
+    ReadOnlyFile(const ReadOnlyFile&) = delete;
+    ReadOnlyFile& operator=(const ReadOnlyFile&) = delete;
+
+    const File& operator*() const noexcept { return file_; }
+    const File* operator->() const noexcept { return &file_; }
+
+private:
+    File file_;
+};
+
+}  // namespace core
+
+#endif
@@ -0,0 +1,247 @@
+/**
+ * @file section_file.h
+ * @brief Self-describing file of typed sections, read in place through a
+ * MemMapFile
+ *
+ */
+
+#ifndef LIB_SECTION_FILE_H
+#define LIB_SECTION_FILE_H
+
+#include "core/mem_map_file.h"
+#include "core/span.h"
+#include "core/string_view.h"
+#include "core/vector.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace core {
+
+namespace internal {
+
+/**
+ * @brief On-disk header of a section file, at offset zero.
+ */
+struct SectionFileHeader {
+    uint64_t magic;
+    uint32_t formatVersion;  // Layout of header and table
+    uint32_t version;        // Version of the data, set by the writer
+    uint64_t sectionCount;
+    uint64_t tableOffset;
+    uint64_t tableChecksum;
+};
+
+/**
+ * @brief Kind of element a section holds, recorded alongside its size so
+ * that, say, a float section is not read as uint32_t. Types without a kind
+ * of their own, such as structs, are Opaque and checked by size alone.
+ */
+enum class SectionKind : uint32_t { Opaque, Signed, Unsigned, Float, Char };
+
+template<typename T>
+constexpr SectionKind SectionKindOf() {
+    if constexpr (std::is_same_v<T, char> || std::is_same_v<T, char8_t>) {
+        return SectionKind::Char;
+    } else if constexpr (std::is_floating_point_v<T>) {
+        return SectionKind::Float;
+    } else if constexpr (std::is_integral_v<T>) {
+        return std::is_signed_v<T> ? SectionKind::Signed : SectionKind::Unsigned;
+    } else {
+        return SectionKind::Opaque;
+    }
+}
+
+/**
+ * @brief On-disk section table entry.
+ */
+struct SectionEntry {
+    uint32_t id;
+    uint32_t elementSize;
+    uint64_t offset;
+    uint64_t size;  // Bytes
+    uint64_t checksum;
+    SectionKind kind;
+    uint32_t reserved;
+};
+
+constexpr uint64_t SectionFileMagic = 0x5443455345524f43ULL;  // "CORESECT"
+constexpr uint32_t SectionFileFormatVersion = 1;
+
+// Sections start on cache line boundaries, so any element type is aligned
+constexpr size_t SectionAlignment = 64;
+
+}  // namespace internal
+
+struct SectionFileOptions {
+    /**
+     * @brief Options for the underlying mapping.
+     */
+    MemMapFileOptions map{.forceInMemory = false};
+
+    /**
+     * @brief Verify the checksum of every section at open. Reads the whole
+     * file once; without it only the header and section table are verified.
+     */
+    bool verifyChecksums{true};
+};
+
+/**
+ * @brief SectionFile opens a file written by SectionFileWriter and hands out
+ * its sections as spans and string views pointing straight into the
+ * mapping. The magic, versions, section table and, optionally, each
+ * section's checksum are validated once at open, after which accessors only
+ * check the requested type against the table: its size, and its kind
+ * (signed, unsigned, floating point or character) where it has one.
+ */
+class SectionFile {
+public:
+    /**
+     * @brief Opens and validates a section file.
+     *
+     * @param path Path of file
+     * @param version Data version the file must have been written with
+     * @param options Mapping and validation options
+     * @throws FileOpenFailure If the file cannot be mapped, or is not a valid
+     * section file of the given version
+     */
+    SectionFile(const std::string& path, uint32_t version, SectionFileOptions options = {});
+
+    SectionFile(const SectionFile&) = delete;
+    SectionFile& operator=(const SectionFile&) = delete;
+
+    uint32_t Version() const { return Header()->version; }
+
+    size_t SectionCount() const { return Header()->sectionCount; }
+
+    bool Contains(uint32_t id) const { return Find(id) != nullptr; }
+
+    /**
+     * @brief Gets the raw bytes of a section.
+     *
+     * @param id Section id
+     * @throws std::out_of_range If there is no such section
+     */
+    core::Span<const char> Bytes(uint32_t id) const;
+
+    /**
+     * @brief Gets a section of elements of type T.
+     *
+     * @param id Section id
+     * @throws std::out_of_range If there is no such section
+     * @throws std::invalid_argument If the section holds elements of another
+     * size or kind
+     */
+    template<typename T>
+        requires std::is_trivially_copyable_v<T>
+    core::Span<const T> Array(uint32_t id) const {
+        const internal::SectionEntry& entry = Get(id);
+        if (entry.elementSize != sizeof(T)) {
+            throw std::invalid_argument("section element size mismatch");
+        }
+        if (entry.kind != internal::SectionKindOf<T>()) {
+            throw std::invalid_argument("section element kind mismatch");
+        }
+        return core::Span<const T>{reinterpret_cast<const T*>(file_.data() + entry.offset), entry.size / sizeof(T)};
+    }
+
+    /**
+     * @brief Gets a string section.
+     *
+     * @param id Section id
+     * @throws std::out_of_range If there is no such section
+     * @throws std::invalid_argument If the section is not a string
+     */
+    core::StringView String(uint32_t id) const {
+        auto chars = Array<char>(id);
+        return core::StringView{chars.Data(), chars.Size()};
+    }
+
+private:
+    const internal::SectionFileHeader* Header() const {
+        return reinterpret_cast<const internal::SectionFileHeader*>(file_.data());
+    }
+
+    const internal::SectionEntry* Find(uint32_t id) const;
+
+    const internal::SectionEntry& Get(uint32_t id) const {
+        const internal::SectionEntry* entry = Find(id);
+        if (entry == nullptr) {
+            throw std::out_of_range("no such section");
+        }
+        return *entry;
+    }
+
+    MemMapFile file_;
+    const internal::SectionEntry* table_{nullptr};
+};
+
+/**
+ * @brief SectionFileWriter writes a section file in one pass. Sections are
+ * written as they are added, and the section table and then the header on
+ * Close, so the file only becomes valid once Close completes; a writer
+ * destroyed without it leaves an invalid file behind. Any existing file at
+ * the path is truncated.
+ */
+class SectionFileWriter {
+public:
+    /**
+     * @param path Path of file to write
+     * @param version Data version recorded in the header
+     */
+    SectionFileWriter(const std::string& path, uint32_t version);
+
+    SectionFileWriter(const SectionFileWriter&) = delete;
+    SectionFileWriter& operator=(const SectionFileWriter&) = delete;
+
+    ~SectionFileWriter();
+
+    /**
+     * @brief Adds a section of elements of type T.
+     *
+     * @param id Section id, unique within the file
+     * @param values Elements of section
+     */
+    template<typename T>
+        requires std::is_trivially_copyable_v<T>
+    void AddArray(uint32_t id, core::Span<const T> values) {
+        AddSection(id, values.Data(), values.Size() * sizeof(T), sizeof(T), internal::SectionKindOf<T>());
+    }
+
+    /**
+     * @brief Adds a string section.
+     *
+     * @param id Section id, unique within the file
+     * @param value String of section
+     */
+    void AddString(uint32_t id, core::StringView value) {
+        AddSection(id, value.Data(), value.Size(), 1, internal::SectionKind::Char);
+    }
+
+    /**
+     * @brief Writes the section table and header, completing the file.
+     * Further additions throw std::runtime_error.
+     */
+    void Close();
+
+private:
+    void AddSection(uint32_t id, const void* data, size_t size, uint32_t element_size, internal::SectionKind kind);
+
+    void CheckOpen() const {
+        if (fd_ == -1) {
+            throw std::runtime_error("section file writer is closed");
+        }
+    }
+
+    int fd_{-1};
+    uint32_t version_;
+    size_t end_;  // Offset past the last section
+    core::Vector<internal::SectionEntry> table_;
+};
+
+}  // namespace core
+
+#endif
@@ -0,0 +1,423 @@
+#ifndef CORE_SHARDED_ORDERED_MAP_FILE_H
+#define CORE_SHARDED_ORDERED_MAP_FILE_H
+
+#include "core/checksum.h"
+#include "core/optional.h"
+#include "core/ordered_map_file.h"
+#include "core/span.h"
+#include "core/thread.h"
+#include "core/vector.h"
+#include "core/vector_file.h"
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace core {
+
+/**
+ * @brief Spreads keys over shards by a hash of their bytes, so any trivially
+ * copyable key works, padded char arrays and POD structs included. Equal keys
+ * must have equal bytes: zero the unused tail of fixed-width strings and any
+ * padding. Keys of one shard are not contiguous in key order.
+ *
+ * @tparam K Key type
+ */
+template<typename K>
+    requires std::is_trivially_copyable_v<K>
+struct HashPartitioner {
+    static constexpr bool Ordered = false;
+
+    size_t operator()(const K& key, size_t shards) const { return Checksum64(&key, sizeof(K)) % shards; }
+};
+
+/**
+ * @brief Splits the keyspace into contiguous ranges at the given split keys,
+ * so shard i holds the keys in [splits[i - 1], splits[i]) and the shards
+ * together are in key order.
+ *
+ * @tparam K Key type
+ * @tparam Compare Comparator of the map
+ */
+template<typename K, TotalOrderComparator<K, K> Compare>
+class RangePartitioner {
+public:
+    static constexpr bool Ordered = true;
+
+    /**
+     * @param splits Sorted keys at which each shard after the first begins.
+     * The map has one more shard than there are splits.
+     * @param compare Comparator of the map
+     */
+    RangePartitioner(core::Vector<K> splits, Compare compare) : splits_(std::move(splits)), compare_(compare) {
+        for (size_t i = 1; i < splits_.size(); ++i) {
+            if (compare_(splits_[i - 1], splits_[i]) >= 0) {
+                throw std::invalid_argument("range splits must be sorted and unique");
+            }
+        }
+    }
+
+    size_t Shards() const { return splits_.size() + 1; }
+
+    const core::Vector<K>& Splits() const { return splits_; }
+
+    size_t operator()(const K& key, size_t /*shards*/) const {
+        return std::upper_bound(splits_.begin(),
+                                splits_.end(),
+                                key,
+                                [&](const K& a, const K& b) { return compare_(a, b) < 0; }) -
+               splits_.begin();
+    }
+
+private:
+    core::Vector<K> splits_;
+    Compare compare_;
+};
+
+namespace internal {
+
+/**
+ * @brief Partitioning a sharded map was created with, kept in the header of
+ * its manifest file. The manifest's elements are the range splits, if any.
+ */
+struct ShardManifest {
+    uint64_t shardCount;
+    uint64_t ordered;  // Whether keys are partitioned by range
+};
+
+}  // namespace internal
+
+/**
+ * @brief ShardedOrderedMapFile splits a map across independent
+ * OrderedMapFile shards, stored at path + ".0", path + ".1" and so on, so the
+ * shards can be written by separate threads. Keys are assigned to shards by
+ * a partitioner, by hash or by key range. Lookups go straight to the key's
+ * shard. Under a range partitioner the shards are in key order, and the map
+ * iterates through them in turn.
+ *
+ * The shard count and any range splits are recorded in a manifest at path +
+ * ".manifest" when the map is created, and reopening it with another
+ * partitioning throws rather than sending keys to the wrong shards.
+ *
+ * Single-key writes are not synchronized. InsertParallel splits a batch by
+ * shard and inserts into every shard at once, one thread each.
+ *
+ * @tparam K Key type
+ * @tparam V Value type
+ * @tparam N Maximum number of entries per node
+ * @tparam Compare Comparator
+ * @tparam Partitioner Callable mapping (key, shard count) to a shard
+ */
+template<typename K,
+         typename V,
+         size_t N,
+         TotalOrderComparator<K, K> Compare,
+         typename Partitioner = HashPartitioner<K>>
+    requires std::is_trivially_copyable_v<K> && std::is_trivially_copyable_v<V>
+class ShardedOrderedMapFile {
+    using ShardMap = OrderedMapFile<K, V, N, Compare>;
+
+public:
+    using ConstPair = typename ShardMap::ConstPair;
+
+    /**
+     * @brief Forward iterator over the pairs of all shards, shard by shard.
+     * In key order under an ordered partitioner.
+     */
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = ConstPair;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = ConstPair;
+
+        Iterator() = default;
+
+        ConstPair operator*() const { return *it_; }
+
+        Iterator& operator++() {
+            ++it_;
+            SkipEmpty();
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return shard_ == other.shard_ && (shard_ == map_->ShardCount() || it_ == other.it_);
+        }
+
+    private:
+        friend class ShardedOrderedMapFile;
+
+        Iterator(const ShardedOrderedMapFile* map, size_t shard) : map_(map), shard_(shard) {
+            if (shard_ < map_->ShardCount()) {
+                it_ = map_->Shard(shard_).begin();
+                SkipEmpty();
+            }
+        }
+
+        void SkipEmpty() {
+            while (it_ == map_->Shard(shard_).end()) {
+                if (++shard_ == map_->ShardCount()) {
+                    return;
+                }
+                it_ = map_->Shard(shard_).begin();
+            }
+        }
+
+        const ShardedOrderedMapFile* map_{nullptr};
+        size_t shard_{0};
+        typename ShardMap::Iterator it_;
+    };
+
+    /**
+     * @brief Creates or opens a ShardedOrderedMapFile at the given path.
+     *
+     * @param path Path prefix of the shard files
+     * @param shards Number of shards; must be the same every time the map
+     * is opened
+     * @param compare Comparator to use for maintaining ordering
+     * @param partitioner Assigns keys to shards
+     * @param options Options for each shard's node file
+     * @throws std::runtime_error If the map exists with a different shard
+     * count or partitioning
+     */
+    ShardedOrderedMapFile(const char* path,
+                          size_t shards,
+                          Compare compare,
+                          Partitioner partitioner = Partitioner{},
+                          VectorFileOptions options = {})
+        : compare_(compare), partitioner_(std::move(partitioner)) {
+        if (shards == 0) {
+            throw std::invalid_argument("sharded map needs at least one shard");
+        }
+        if constexpr (Partitioner::Ordered) {
+            if (shards != partitioner_.Shards()) {
+                throw std::invalid_argument("shard count does not match partitioner ranges");
+            }
+        }
+        CheckManifest(path, shards, options.readOnly);
+        for (size_t i = 0; i < shards; ++i) {
+            std::string shard_path = std::string{path} + "." + std::to_string(i);
+            shards_.push_back(std::make_unique<ShardMap>(shard_path.c_str(), compare, options));
+        }
+    }
+
+    /**
+     * @brief Creates or opens a range-partitioned ShardedOrderedMapFile, with
+     * one shard per range of the partitioner.
+     */
+    ShardedOrderedMapFile(const char* path, Compare compare, Partitioner partitioner, VectorFileOptions options = {})
+        requires Partitioner::Ordered
+        : ShardedOrderedMapFile(path, partitioner.Shards(), compare, partitioner, options) {}
+
+    size_t ShardCount() const { return shards_.size(); }
+
+    const ShardMap& Shard(size_t shard) const { return *shards_[shard]; }
+
+    size_t Size() const {
+        size_t size = 0;
+        for (const auto& shard : shards_) {
+            size += shard->Size();
+        }
+        return size;
+    }
+
+    bool Empty() const { return Size() == 0; }
+
+    /**
+     * @brief Index of the shard a key belongs to.
+     */
+    size_t ShardOf(const K& key) const { return partitioner_(key, shards_.size()); }
+
+    /**
+     * @brief Attempts to insert a key-value pair into the map.
+     *
+     * @param key Key to insert
+     * @param val Value to insert
+     * @return true Insertion occurred
+     * @return false Insertion did not occur -- key already present
+     */
+    bool Insert(K key, V val) { return shards_[ShardOf(key)]->Insert(key, val); }
+
+    /**
+     * @brief Inserts a key-value pair, or assigns the value if the key is
+     * already present.
+     *
+     * @return true Insertion occurred
+     * @return false Existing value was assigned
+     */
+    bool InsertOrAssign(K key, V val) { return shards_[ShardOf(key)]->InsertOrAssign(key, val); }
+
+    /**
+     * @brief Removes a key from the map.
+     *
+     * @return Whether the key was present
+     */
+    bool Erase(const K& key) { return shards_[ShardOf(key)]->Erase(key); }
+
+    /**
+     * @brief Inserts a batch of key-value pairs, with one thread per shard.
+     * The batch is split by shard, and each shard's pairs are sorted by key
+     * and inserted in order, or bulk loaded if the shard is empty. As with
+     * Insert, a key already present is left alone, and of several pairs with
+     * the same key the first is kept.
+     *
+     * @param first Beginning of range of pairs, with .first and .second
+     * @param last End of range of pairs
+     * @return size_t Number of pairs inserted
+     */
+    template<std::forward_iterator It>
+    size_t InsertParallel(It first, It last) {
+        core::Vector<core::Vector<std::pair<K, V>>> batches(shards_.size());
+        for (; first != last; ++first) {
+            const auto& entry = *first;
+            batches[ShardOf(entry.first)].push_back(std::pair<K, V>{entry.first, entry.second});
+        }
+
+        core::Vector<size_t> inserted(shards_.size(), 0);
+        core::Vector<std::exception_ptr> errors(shards_.size());
+        core::Vector<core::Thread> threads;
+        // Reserved up front so that adding a started thread cannot throw
+        threads.reserve(shards_.size());
+        try {
+            for (size_t i = 0; i < shards_.size(); ++i) {
+                threads.push_back(core::Thread([&, i] {
+                    try {
+                        inserted[i] = InsertSorted(*shards_[i], batches[i]);
+                    } catch (...) {
+                        errors[i] = std::current_exception();
+                    }
+                }));
+            }
+        } catch (...) {
+            // Threads already started use the batches and results above
+            for (auto& thread : threads) {
+                thread.Join();
+            }
+            throw;
+        }
+        for (auto& thread : threads) {
+            thread.Join();
+        }
+
+        for (const auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+        size_t total = 0;
+        for (size_t count : inserted) {
+            total += count;
+        }
+        return total;
+    }
+
+    /**
+     * @brief Finds a key-value pair in the map.
+     *
+     * @param key Key to look up
+     * @return Found pair, if key is in map.
+     */
+    core::Optional<ConstPair> Find(const K& key) const { return Shard(ShardOf(key)).Find(key); }
+
+    bool Contains(const K& key) const { return Shard(ShardOf(key)).Contains(key); }
+
+    Iterator begin() const
+        requires Partitioner::Ordered
+    {
+        return Iterator{this, 0};
+    }
+
+    Iterator end() const
+        requires Partitioner::Ordered
+    {
+        return Iterator{this, shards_.size()};
+    }
+
+private:
+    using Manifest = CustomVectorFile<K, internal::ShardManifest>;
+
+    /**
+     * @brief Records the partitioning in the manifest of a new map, or checks
+     * it against the manifest of an existing one.
+     */
+    void CheckManifest(const char* path, size_t shards, bool read_only) const {
+        std::string manifest_path = std::string{path} + ".manifest";
+        Manifest manifest(manifest_path.c_str(),
+                          VectorFileOptions{.readOnly = read_only, .durability = Durability::Explicit});
+
+        const internal::ShardManifest* recorded = std::as_const(manifest).CustomData();
+        if (recorded->shardCount == 0) {
+            if (read_only) {
+                throw std::runtime_error("sharded map manifest is empty");
+            }
+            *manifest.CustomData() = internal::ShardManifest{
+                .shardCount = shards,
+                .ordered = Partitioner::Ordered,
+            };
+            if constexpr (HasSplits) {
+                const core::Vector<K>& splits = partitioner_.Splits();
+                manifest.Append(core::Span<const K>{splits.data(), splits.size()});
+            }
+            manifest.Commit();
+            return;
+        }
+
+        bool matches = recorded->shardCount == shards && recorded->ordered == Partitioner::Ordered;
+        if constexpr (HasSplits) {
+            const core::Vector<K>& splits = partitioner_.Splits();
+            matches = matches && manifest.Size() == splits.size();
+            for (size_t i = 0; matches && i < splits.size(); ++i) {
+                matches = compare_(std::as_const(manifest)[i], splits[i]) == 0;
+            }
+        }
+        if (!matches) {
+            throw std::runtime_error("sharded map was created with a different partitioning");
+        }
+    }
+
+    static constexpr bool HasSplits = requires(const Partitioner& partitioner) {
+        { partitioner.Splits() } -> std::convertible_to<const core::Vector<K>&>;
+    };
+
+    size_t InsertSorted(ShardMap& shard, core::Vector<std::pair<K, V>>& batch) const {
+        std::stable_sort(batch.begin(), batch.end(), [&](const auto& a, const auto& b) {
+            return compare_(a.first, b.first) < 0;
+        });
+        auto unique_end = std::unique(batch.begin(), batch.end(), [&](const auto& a, const auto& b) {
+            return compare_(a.first, b.first) == 0;
+        });
+
+        if (shard.Empty()) {
+            return shard.BulkLoad(batch.begin(), unique_end);
+        }
+        size_t inserted = 0;
+        for (auto it = batch.begin(); it != unique_end; ++it) {
+            inserted += static_cast<size_t>(shard.Insert(it->first, it->second));
+        }
+        return inserted;
+    }
+
+    core::Vector<std::unique_ptr<ShardMap>> shards_;
+    Compare compare_;
+    Partitioner partitioner_;
+};
+
+}  // namespace core
+
+#endif
@@ -1,11 +1,22 @@
 #ifndef CORE_VECTOR_FILE_H
 #define CORE_VECTOR_FILE_H
 
+#include "core/checksum.h"
+#include "core/locks.h"
+#include "core/mapping.h"
+#include "core/mutex.h"
+#include "core/span.h"
+
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
+#include <cstdint>
 #include <cstring>
+#include <memory>
+#include <sched.h>
 #include <stdexcept>
 #include <sys/fcntl.h>
 #include <sys/mman.h>
@@ -13,6 +24,13 @@
 #include <sys/unistd.h>
 #include <type_traits>
 #include <unistd.h>
+#include <utility>
+
+// posix_fallocate belongs to the optional POSIX advisory information option,
+// which macOS does not implement
+#if defined(_POSIX_ADVISORY_INFO) && _POSIX_ADVISORY_INFO > 0
+#define LIB_VECTOR_FILE_FALLOCATE 1
+#endif
 
 namespace core {
 
@@ -24,8 +42,105 @@ template<typename T>
 concept ValidCustomData = std::is_trivially_copyable_v<T> && std::has_unique_object_representations_v<T>;
 struct Empty {};
 
+constexpr uint64_t VectorFileMagic = 0x4643455645524f43ULL;  // "COREVECF"
+
+// Version 1 is the first header to carry the magic number. Files written
+// before it began with the capacity and size; they are refused at open and
+// there is no conversion, so they must be rebuilt from their source data.
+constexpr uint32_t VectorFileFormatVersion = 1;
+
 }  // namespace internal
 
+/**
+ * @brief Expected access pattern of a mapping, passed to the kernel through
+ * madvise.
+ */
+enum class AccessHint { Normal, Sequential, Random, WillNeed };
+
+/**
+ * @brief When appended data is made durable.
+ *
+ * None: the header size is updated on every append and nothing is synced;
+ * after a crash the header may point at data that never reached disk.
+ *
+ * Periodic: appends are committed automatically every commitInterval elements.
+ *
+ * Explicit: appends are committed only by Commit() (and on close).
+ *
+ * In both durable modes a commit syncs the newly appended data range before
+ * publishing the new size in the header, together with a checksum of the
+ * committed range. Many appends share one flush.
+ */
+enum class Durability { None, Periodic, Explicit };
+
+/**
+ * @brief Options controlling how a VectorFile maps its backing file.
+ */
+struct VectorFileOptions {
+    /**
+     * @brief Bytes of virtual address space to reserve for the mapping. When
+     * non-zero, the file is mapped at a fixed address at the start of the
+     * reservation and grows in place, so growth never moves the mapping and
+     * already-resident pages are not faulted in again. Growing the file past
+     * the reservation throws std::length_error.
+     */
+    size_t reserveBytes{0};
+
+    /**
+     * @brief Allocate disk blocks with posix_fallocate whenever the file
+     * grows, instead of extending it sparsely with ftruncate. Ignored on
+     * systems without posix_fallocate.
+     */
+    bool fallocate{false};
+
+    /**
+     * @brief Open an existing file for reading only. The file is mapped
+     * PROT_READ and is never created, resized or written to, so processes
+     * sharing the file share one clean page-cache copy. Operations that
+     * change the size or header (PushBack, Append, Reserve, Commit and the
+     * like) throw std::runtime_error. Element and custom data accessors are
+     * not checked, and writing through the non-const ones faults, so open
+     * read-only files through ReadOnlyFile, which only hands out a const
+     * reference to the file.
+     */
+    bool readOnly{false};
+
+    /**
+     * @brief Access pattern hint applied to the mapping.
+     */
+    AccessHint access{AccessHint::Normal};
+
+    /**
+     * @brief Durability policy for appended data.
+     */
+    Durability durability{Durability::None};
+
+    /**
+     * @brief Number of appended elements between automatic commits under
+     * Durability::Periodic.
+     */
+    size_t commitInterval{65536};
+
+    /**
+     * @brief Back the mapping with transparent huge pages where the kernel
+     * allows it. The mapping is 2 MiB aligned, madvised MADV_HUGEPAGE, and the
+     * file grows in 2 MiB steps so its layout matches. Whether huge pages are
+     * actually used depends on the kernel and filesystem; see HugePageBytes().
+     */
+    bool hugePages{false};
+
+    /**
+     * @brief Version of the element and custom data layout, chosen by the
+     * owner of the file and recorded when it is created. Opening a file
+     * recorded with another version throws std::runtime_error, so a change to
+     * the element type is caught instead of misreading old data.
+     */
+    uint32_t layoutVersion{0};
+};
+
+template<typename T, typename CustomDataType>
+class CustomVectorFileWriter;
+
 /**
  * @brief VectorFile is a vector-like data structure that is backed by a
  * memory-mapped file. It supports O(1) random access, push back, and pop back.
@@ -43,14 +158,38 @@ template<typename T, typename CustomDataType>
 class CustomVectorFile {
     using CustomDataT = std::conditional_t<std::is_same_v<CustomDataType, void>, internal::Empty, CustomDataType>;
 
+    // Writes the same on-disk format without mapping it
+    friend class CustomVectorFileWriter<T, CustomDataType>;
+
     struct FileHeader {
+        uint64_t magic;
+        uint32_t formatVersion;   // Layout of this header
+        uint32_t layoutVersion;   // Layout of elements and custom data, set by the owner
+        uint32_t elementSize;
+        uint32_t customDataSize;
         size_t capacity;
         size_t size;
+        size_t checkpoint;  // size as of the commit before the last one
+        uint64_t checksum;  // checksum of [checkpoint, size), 0 if untracked
     };
 
     static_assert(std::has_unique_object_representations_v<FileHeader>,
                   "FileHeader must have a unique object representation (no padding)");
 
+    /**
+     * @brief A mapping shared by the file and the snapshots reading from it,
+     * unmapped when the last of them lets go.
+     */
+    struct MappingLease {
+        void* addr;
+        size_t length;
+
+        MappingLease(void* addr, size_t length) : addr(addr), length(length) {}
+        MappingLease(const MappingLease&) = delete;
+        MappingLease& operator=(const MappingLease&) = delete;
+        ~MappingLease() { munmap(addr, length); }
+    };
+
 public:
     static constexpr size_t CustomDataSize = std::is_same_v<CustomDataType, void> ? 0 : sizeof(CustomDataT);
 
@@ -70,15 +209,57 @@ public:
     static constexpr size_t InitialCapacity = EntriesPerPage;
 
     /**
-     * @brief Creates or opens a VectorFile at the given path.
+     * @brief A consistent read-only view of a prefix of a VectorFile, pinning
+     * the elements that were published when it was taken along with the
+     * mapping they live in. Reading a snapshot takes no locks and is not
+     * disturbed by later appends or remaps, and the snapshot may outlive the
+     * file. Elements popped and overwritten after the snapshot was taken are
+     * not protected.
+     */
+    class Snapshot {
+    public:
+        Snapshot() = default;
+
+        size_t Size() const { return size_; }
+        bool Empty() const { return size_ == 0; }
+
+        const T* Data() const { return data_; }
+
+        const T& operator[](size_t n) const {
+            if (n >= size_) {
+                throw std::out_of_range("index out of range");
+            }
+            return data_[n];
+        }
+
+        const T* begin() const { return data_; }
+        const T* end() const { return data_ + size_; }
+
+    private:
+        friend class CustomVectorFile;
+
+        Snapshot(std::shared_ptr<const MappingLease> mapping, size_t size)
+            : mapping_(std::move(mapping)),
+              data_(reinterpret_cast<const T*>(static_cast<const char*>(mapping_->addr) + HeaderSpace)),
+              size_(size) {}
+
+        std::shared_ptr<const MappingLease> mapping_;
+        const T* data_{nullptr};
+        size_t size_{0};
+    };
+
+    /**
+     * @brief Creates or opens a VectorFile at the given path. In read-only
+     * mode, the file must already exist.
      *
      * @param path Path of backing file
+     * @param options Mapping options
      */
-    CustomVectorFile(const char* path) {
+    CustomVectorFile(const char* path, VectorFileOptions options = {}) : options_(options) {
         bool exists = access(path, F_OK) != -1;
 
         // Create/open file
-        fd_ = open(path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+        fd_ = options.readOnly ? open(path, O_RDONLY) : open(path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
         if (fd_ == -1) {
             throw std::runtime_error("failed to open file");
         }
@@ -91,35 +272,74 @@ public:
                 throw std::runtime_error("failed to get file size");
             }
             file_size_ = st.st_size;
+            if (file_size_ < HeaderSpace) {
+                close(fd_);
+                throw std::runtime_error("file too small for vector file header");
+            }
+            CheckHeader(options.layoutVersion);
         } else {
             // Initialize file
             file_size_ = HeaderSpace + (InitialCapacity * sizeof(T));
+            if (options.hugePages) {
+                file_size_ = RoundUpToGranularity(file_size_);
+            }
             if (ftruncate(fd_, file_size_) == -1) {
                 close(fd_);
                 throw std::runtime_error("failed to initialize file");
             }
         }
 
+        if (options.reserveBytes != 0) {
+            // Reserve address space for in-place growth
+            reserved_length_ = RoundUpToGranularity(std::max(options.reserveBytes, file_size_));
+            void* reservation = ReserveAddressSpace(reserved_length_, Granularity());
+            if (reservation == nullptr) {
+                close(fd_);
+                throw std::runtime_error("failed to reserve address space");
+            }
+            mapped_ = reservation;
+        }
+
         // Map file into memory
-        mapped_ = mmap(nullptr, file_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
-        if (mapped_ == MAP_FAILED) {
+        if (!MapRange(0, RoundUpToPage(file_size_))) {
+            if (mapped_ != nullptr) {
+                munmap(mapped_, reserved_length_);
+            }
             close(fd_);
             throw std::runtime_error("failed to map file");
         }
+        Advise(options.access);
 
         if (!exists) {
             // Initialize header data
-            Header()->capacity = InitialCapacity;
-            Header()->size = 0;
+            *Header() = NewHeader(options.layoutVersion);
+            Header()->capacity = (file_size_ - HeaderSpace) / sizeof(T);
         }
 
-        capacity_ = Header()->capacity;
-        size_ = Header()->size;
+        Recover();
+        committed_.store(Size(), std::memory_order_relaxed);
+
+        if (!options.readOnly && options.durability == Durability::None && Header()->checksum != 0) {
+            // Sizes published from now on are not checksummed
+            Header()->checksum = 0;
+        }
     }
 
     ~CustomVectorFile() {
-        if (mapped_ != nullptr) {
-            munmap(mapped_, file_size_);
+        if (!options_.readOnly && options_.durability != Durability::None && mapped_ != nullptr) {
+            try {
+                Commit();
+            } catch (...) {
+                // Uncommitted appends are lost as if the process had crashed
+            }
+        }
+
+        if (snapshots_enabled_.load(std::memory_order_relaxed)) {
+            // Mapping is unmapped once the last snapshot is released
+            current_lease_.store(nullptr, std::memory_order_release);
+            mapped_ = nullptr;
+        } else if (mapped_ != nullptr) {
+            munmap(mapped_, StableAddress() ? reserved_length_ : mapped_length_);
             mapped_ = nullptr;
         }
         if (fd_ != -1) {
@@ -128,34 +348,96 @@ public:
         }
     }
 
-    size_t Size() const { return size_; }
-    size_t Capacity() const { return capacity_; }
-    bool Empty() const { return size_ == 0; }
+    /**
+     * @brief Number of elements in the vector. During concurrent appends, this
+     * is the published watermark: every element below it is fully written.
+     */
+    size_t Size() const { return size_.load(std::memory_order_acquire); }
+    size_t Capacity() const { return capacity_.load(std::memory_order_acquire); }
+    bool Empty() const { return Size() == 0; }
+
+    /**
+     * @brief Whether the mapping lives in a reserved address range and keeps
+     * a fixed address across growth.
+     */
+    bool StableAddress() const { return reserved_length_ != 0; }
+
+    /**
+     * @brief Whether opening the file found a torn tail (a published size
+     * whose data did not match its checksum) and truncated it away.
+     */
+    bool RecoveredTornTail() const { return recovered_torn_tail_; }
+
+    /**
+     * @brief Number of bytes of the mapping currently backed by huge pages.
+     */
+    size_t HugePageBytes() const { return HugePageBackedBytes(mapped_, mapped_length_); }
+
+    /**
+     * @brief Number of elements known to be durable on disk.
+     */
+    size_t CommittedSize() const { return committed_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Whether the file was opened read-only.
+     */
+    bool ReadOnly() const { return options_.readOnly; }
+
+    /**
+     * @brief Descriptor of the backing file, for advice such as posix_fadvise
+     * on ranges of it. Elements start HeaderSpace bytes into the file.
+     */
+    int FileDescriptor() const { return fd_; }
+
+    /**
+     * @brief Applies an access pattern hint to the mapped file.
+     *
+     * @param hint Expected access pattern
+     */
+    void Advise(AccessHint hint) const {
+        int advice = MADV_NORMAL;
+        switch (hint) {
+        case AccessHint::Normal:
+            advice = MADV_NORMAL;
+            break;
+        case AccessHint::Sequential:
+            advice = MADV_SEQUENTIAL;
+            break;
+        case AccessHint::Random:
+            advice = MADV_RANDOM;
+            break;
+        case AccessHint::WillNeed:
+            advice = MADV_WILLNEED;
+            break;
+        }
+        // Advice is best effort, ignore failures
+        madvise(mapped_, mapped_length_, advice);
+    }
 
     T* Data() { return reinterpret_cast<T*>(static_cast<char*>(mapped_) + HeaderSpace); }
     const T* Data() const { return reinterpret_cast<const T*>(static_cast<char*>(mapped_) + HeaderSpace); }
 
     T& operator[](size_t n) {
-        if (n >= size_) {
+        if (n >= Size()) {
             throw std::out_of_range("index out of range");
         }
         return Data()[n];
     }
 
     const T& operator[](size_t n) const {
-        if (n >= size_) {
+        if (n >= Size()) {
             throw std::out_of_range("index out of range");
         }
         return Data()[n];
     }
 
     T& Front() { return (*this)[0]; }
-    T& Back() { return (*this)[size_ - 1]; }
+    T& Back() { return (*this)[Size() - 1]; }
 
     T* begin() { return Data(); }
-    T* end() { return Data()[size_]; }
+    T* end() { return Data() + Size(); }
     const T* begin() const { return Data(); }
-    const T* end() const { return Data()[size_]; }
+    const T* end() const { return Data() + Size(); }
 
     /**
      * @brief Reserves enough space for a number of elements. May over-reserve.
@@ -163,42 +445,288 @@ public:
      * @param capacity Capacity to reserve for
      */
     void Reserve(size_t capacity) {
-        if (capacity_ >= capacity) {
+        CheckWritable();
+        if (Capacity() >= capacity) {
             return;
         }
         ForceResize(capacity);
     }
 
+    /**
+     * @brief Reserves space for a number of elements and allocates the disk
+     * blocks and page mappings backing it up front, so that later appends do
+     * not fault. Without posix_fallocate the disk blocks are left sparse.
+     *
+     * @param capacity Capacity to preallocate for
+     */
+    void Preallocate(size_t capacity) {
+        Reserve(capacity);
+
+        size_t begin = HeaderSpace + (Size() * sizeof(T));
+        size_t end = HeaderSpace + (capacity * sizeof(T));
+        if (end <= begin) {
+            return;
+        }
+#ifdef LIB_VECTOR_FILE_FALLOCATE
+        if (posix_fallocate(fd_, static_cast<off_t>(begin), static_cast<off_t>(end - begin)) != 0) {
+            throw std::runtime_error("failed to preallocate file");
+        }
+#endif
+#ifdef MADV_POPULATE_WRITE
+        size_t page_begin = begin & ~(PageSize - 1);
+        // Best effort: older kernels reject the advice and fault lazily
+        madvise(static_cast<char*>(mapped_) + page_begin, RoundUpToPage(end) - page_begin, MADV_POPULATE_WRITE);
+#endif
+    }
+
+    /**
+     * @brief Appends a range of values to the end of the vector. The file is
+     * grown at most once and the new size is published once. May invalidate
+     * pointers and iterators, unless the mapping has a stable address.
+     *
+     * @param values Values to append
+     */
+    void Append(core::Span<const T> values) {
+        CheckWritable();
+        ReserveForAppend(values.Size());
+        size_t size = Size();
+        std::memcpy(Data() + size, values.Data(), values.Size() * sizeof(T));
+        PublishSize(size + values.Size());
+    }
+
+    /**
+     * @brief Appends count values produced by a generator to the end of the
+     * vector. The file is grown at most once and the new size is published
+     * once. May invalidate pointers and iterators, unless the mapping has a
+     * stable address.
+     *
+     * @param count Number of values to append
+     * @param generate Invoked with the index of each new element, returning
+     * the value to store there
+     */
+    template<typename Generator>
+        requires std::is_invocable_r_v<T, Generator&, size_t>
+    void AppendN(size_t count, Generator&& generate) {
+        CheckWritable();
+        ReserveForAppend(count);
+        T* out = Data();
+        size_t size = Size();
+        for (size_t i = size; i < size + count; ++i) {
+            out[i] = generate(i);
+        }
+        PublishSize(size + count);
+    }
+
     /**
      * @brief Pushes the value to the end of the vector. May invalidate pointers
-     * and iterators.
+     * and iterators, unless the mapping has a stable address.
      *
      * @param value Value to push
      */
     void PushBack(const T& value) {
-        if (size_ >= capacity_) {
-            ForceResize(capacity_ * 2);
+        CheckWritable();
+        size_t size = Size();
+        if (size >= Capacity()) {
+            ForceResize(Capacity() * 2);
+        }
+        Data()[size] = value;
+        PublishSize(size + 1);
+    }
+
+    /**
+     * @brief Appends values to the end of the vector from any number of
+     * threads at once. Each call atomically reserves a range of slots and
+     * copies into it in parallel with other appenders. Growth is serialized,
+     * but since it never moves the mapping it does not disturb readers or
+     * appenders writing below the old capacity. Ranges are published in slot
+     * order, so every element below Size() is fully written.
+     *
+     * Requires a stable address. Must not run concurrently with the other
+     * mutating operations.
+     *
+     * @param values Values to append
+     * @return size_t Index of the first appended element
+     */
+    size_t ConcurrentAppend(core::Span<const T> values) {
+        CheckWritable();
+        if (!StableAddress()) {
+            throw std::runtime_error("concurrent append requires a stable address");
+        }
+
+        size_t begin = next_slot_.fetch_add(values.Size(), std::memory_order_relaxed);
+        size_t end = begin + values.Size();
+        if (end > Capacity()) {
+            GrowForConcurrentAppend(end);
+        }
+        std::memcpy(Data() + begin, values.Data(), values.Size() * sizeof(T));
+
+        // Wait for all preceding ranges to be published, then publish ours
+        for (size_t spins = 0; size_.load(std::memory_order_acquire) != begin; ++spins) {
+            if (append_failed_.load(std::memory_order_relaxed)) {
+                throw std::runtime_error("concurrent append failed");
+            }
+            if (spins >= SpinsBeforeYield) {
+                sched_yield();
+            }
         }
-        Data()[size_] = value;
-        ++size_;
-        Header()->size = size_;
+        if (options_.durability == Durability::None) {
+            Header()->size = end;
+        }
+        size_.store(end, std::memory_order_release);
+
+        if (options_.durability == Durability::Periodic &&
+            end - committed_.load(std::memory_order_relaxed) >= options_.commitInterval) {
+            Commit();
+        }
+        return begin;
     }
 
+    /**
+     * @brief Pushes a value to the end of the vector from any number of
+     * threads at once. See ConcurrentAppend.
+     *
+     * @param value Value to push
+     * @return size_t Index of the pushed element
+     */
+    size_t ConcurrentPushBack(const T& value) { return ConcurrentAppend(core::Span<const T>{&value, 1}); }
+
     /**
      * @brief Pops the value at the end of the vector off. May invalidate
-     * pointers and iterators.
+     * pointers and iterators, unless the mapping has a stable address.
      */
     void PopBack() {
-        if (size_ == 0) {
+        CheckWritable();
+        size_t size = Size();
+        if (size == 0) {
             throw std::out_of_range("index out of range");
         }
 
-        --size_;
-        Header()->size = size_;
+        --size;
+        if (committed_.load(std::memory_order_relaxed) > size) {
+            committed_.store(size, std::memory_order_relaxed);
+        }
+        PublishSize(size);
 
-        if (size_ < capacity_ / 4 && capacity_ > InitialCapacity * 2) {
-            ForceResize(capacity_ / 2);
+        size_t capacity = Capacity();
+        bool shrinks = RoundUpToGranularity(HeaderSpace + (capacity / 2 * sizeof(T))) < file_size_;
+        if (size < capacity / 4 && capacity > InitialCapacity * 2 && shrinks) {
+            if (options_.durability != Durability::None) {
+                // Published size must fit in the shrunk file
+                Commit();
+            }
+            ForceResize(capacity / 2);
+        }
+    }
+
+    /**
+     * @brief Removes all elements and shrinks the file back to its initial
+     * capacity. May invalidate pointers and iterators, unless the mapping has
+     * a stable address.
+     */
+    void Clear() {
+        CheckWritable();
+        committed_.store(0, std::memory_order_relaxed);
+        PublishSize(0);
+        if (options_.durability != Durability::None) {
+            // Published size must fit in the shrunk file
+            Commit();
         }
+        ForceResize(InitialCapacity);
+    }
+
+    /**
+     * @brief Makes all appends so far durable. The appended data range is
+     * synced first, then the new size is published in the header along with
+     * a checksum of the data committed by this call, and the header (and
+     * custom data) is synced.
+     *
+     * Safe to call from concurrent appenders: commits are serialized, and
+     * each one covers everything published so far, so appenders arriving
+     * while a commit is in flight share the next flush.
+     *
+     * @return size_t Number of elements committed
+     */
+    size_t Commit() {
+        CheckWritable();
+        LockGuard lock(commit_mutex_);
+
+        size_t committed = committed_.load(std::memory_order_relaxed);
+        size_t size = Size();
+        size_t begin = HeaderSpace + (committed * sizeof(T));
+        size_t end = HeaderSpace + (size * sizeof(T));
+        if (end > begin) {
+            SyncRange(begin, end);
+        }
+
+        bool published = committed == size && Header()->size == size;
+        if (options_.durability != Durability::None && !published) {
+            Header()->checkpoint = committed;
+            Header()->size = size;
+            Header()->checksum = ComputeChecksum(committed, size);
+        }
+        SyncRange(0, HeaderSpace);
+
+        committed_.store(size, std::memory_order_release);
+        return size;
+    }
+
+    /**
+     * @brief Syncs every element to disk, not just those appended since the
+     * last commit, and then commits. Needed when elements are modified in
+     * place, which Commit does not track.
+     */
+    void Sync() {
+        CheckWritable();
+        size_t size = Size();
+        if (size > 0) {
+            SyncRange(HeaderSpace, HeaderSpace + (size * sizeof(T)));
+        }
+        Commit();
+    }
+
+    /**
+     * @brief Takes a snapshot of the elements published so far. Safe to call
+     * from any thread while a writer appends; besides the first call, which
+     * hands ownership of the mapping over to a shared lease, it only waits on
+     * a concurrent remap. Once snapshots are in use the file no longer shrinks
+     * its capacity in PopBack, since the shrunk tail could still be read.
+     *
+     * @return Snapshot View of the published prefix
+     */
+    Snapshot TakeSnapshot() const {
+        if (!snapshots_enabled_.load(std::memory_order_acquire)) {
+            EnableSnapshots();
+        }
+
+        // The size is loaded first: growth publishes the new mapping before
+        // any element written into it, so the lease covers at least size
+        size_t size = Size();
+        auto lease = current_lease_.load(std::memory_order_acquire);
+        size_t capacity = (lease->length - HeaderSpace) / sizeof(T);
+        return Snapshot{std::move(lease), std::min(size, capacity)};
+    }
+
+    /**
+     * @brief Exchanges the files behind two VectorFiles, along with their
+     * mappings and snapshot leases. Neither may be in use by another thread.
+     *
+     * @param other File to exchange with
+     */
+    void Swap(CustomVectorFile& other) noexcept {
+        std::swap(options_, other.options_);
+        std::swap(fd_, other.fd_);
+        std::swap(mapped_, other.mapped_);
+        std::swap(file_size_, other.file_size_);
+        std::swap(mapped_length_, other.mapped_length_);
+        std::swap(reserved_length_, other.reserved_length_);
+        std::swap(recovered_torn_tail_, other.recovered_torn_tail_);
+        SwapAtomic(capacity_, other.capacity_);
+        SwapAtomic(size_, other.size_);
+        SwapAtomic(next_slot_, other.next_slot_);
+        SwapAtomic(committed_, other.committed_);
+        SwapAtomic(append_failed_, other.append_failed_);
+        SwapAtomic(current_lease_, other.current_lease_);
+        SwapAtomic(snapshots_enabled_, other.snapshots_enabled_);
     }
 
     /**
@@ -218,28 +746,300 @@ public:
 private:
     FileHeader* Header() const { return static_cast<FileHeader*>(mapped_); }
 
+    template<typename A>
+    static void SwapAtomic(std::atomic<A>& a, std::atomic<A>& b) noexcept {
+        b.store(a.exchange(b.load(std::memory_order_relaxed), std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    static constexpr size_t SpinsBeforeYield = 64;
+
+    /**
+     * @brief Hands ownership of the current mapping to a shared lease, after
+     * which remaps retire old mappings instead of unmapping them.
+     */
+    void EnableSnapshots() const {
+        LockGuard lock(remap_mutex_);
+        if (snapshots_enabled_.load(std::memory_order_relaxed)) {
+            return;
+        }
+        size_t length = StableAddress() ? reserved_length_ : mapped_length_;
+        current_lease_.store(std::make_shared<const MappingLease>(mapped_, length), std::memory_order_release);
+        snapshots_enabled_.store(true, std::memory_order_release);
+    }
+
+    /**
+     * @brief Sets the size of the vector, making it visible according to the
+     * durability policy.
+     */
+    void PublishSize(size_t size) {
+        next_slot_.store(size, std::memory_order_relaxed);
+        size_.store(size, std::memory_order_release);
+
+        switch (options_.durability) {
+        case Durability::None:
+            Header()->size = size;
+            break;
+        case Durability::Periodic:
+            if (size - committed_.load(std::memory_order_relaxed) >= options_.commitInterval) {
+                Commit();
+            }
+            break;
+        case Durability::Explicit:
+            break;
+        }
+    }
+
+    /**
+     * @brief Checksum of the elements in [begin, end), bound to the range.
+     */
+    uint64_t ComputeChecksum(size_t begin, size_t end) const {
+        uint64_t checksum = Checksum64(Data() + begin, (end - begin) * sizeof(T), (begin << 32) ^ end);
+        // Zero is reserved for untracked headers
+        return checksum == 0 ? 1 : checksum;
+    }
+
+    /**
+     * @brief Header describing a new file of this type.
+     */
+    static FileHeader NewHeader(uint32_t layout_version) {
+        return FileHeader{
+            .magic = internal::VectorFileMagic,
+            .formatVersion = internal::VectorFileFormatVersion,
+            .layoutVersion = layout_version,
+            .elementSize = sizeof(T),
+            .customDataSize = CustomDataSize,
+            .capacity = 0,
+            .size = 0,
+            .checkpoint = 0,
+            .checksum = 0,
+        };
+    }
+
+    /**
+     * @brief Reads the header of an existing file before it is mapped and
+     * checks that it is a vector file of this type, closing the file and
+     * throwing std::runtime_error if not. Files written before the header
+     * carried a magic number are rejected rather than misread.
+     */
+    void CheckHeader(uint32_t layout_version) {
+        FileHeader header{};
+        FileHeader expected = NewHeader(layout_version);
+        const char* error = nullptr;
+        if (pread(fd_, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+            error = "failed to read vector file header";
+        } else if (header.magic != expected.magic || header.formatVersion != expected.formatVersion) {
+            error = "not a vector file, or written in an unsupported format";
+        } else if (header.elementSize != expected.elementSize || header.customDataSize != expected.customDataSize ||
+                   header.layoutVersion != expected.layoutVersion) {
+            error = "vector file element layout mismatch";
+        }
+        if (error != nullptr) {
+            close(fd_);
+            throw std::runtime_error(error);
+        }
+    }
+
+    /**
+     * @brief Validates the published size against the header checksum and
+     * capacity, truncating back to the last checkpoint if the tail is torn.
+     * Only the most recently committed range is verified.
+     */
+    void Recover() {
+        FileHeader* header = Header();
+        size_t file_capacity = (file_size_ - HeaderSpace) / sizeof(T);
+        size_t capacity = std::min(header->capacity, file_capacity);
+        size_t size = header->size;
+        bool repair = header->capacity > file_capacity;
+
+        bool torn = size > capacity;
+        if (!torn && header->checksum != 0) {
+            torn = header->checkpoint > size || header->checksum != ComputeChecksum(header->checkpoint, size);
+        }
+        if (torn) {
+            recovered_torn_tail_ = true;
+            size = header->checkpoint <= std::min(size, capacity) ? header->checkpoint : 0;
+            repair = true;
+        }
+
+        capacity_.store(capacity, std::memory_order_relaxed);
+        next_slot_.store(size, std::memory_order_relaxed);
+        size_.store(size, std::memory_order_relaxed);
+
+        if (repair && !options_.readOnly) {
+            header->capacity = capacity;
+            header->size = size;
+            header->checkpoint = size;
+            header->checksum = 0;
+            SyncRange(0, HeaderSpace);
+        }
+    }
+
+    /**
+     * @brief Synchronously flushes the mapped byte range [begin, end) of the
+     * file to disk.
+     */
+    void SyncRange(size_t begin, size_t end) {
+        size_t page_begin = begin & ~(PageSize - 1);
+        if (msync(static_cast<char*>(mapped_) + page_begin, end - page_begin, MS_SYNC) == -1) {
+            throw std::runtime_error("failed to sync file");
+        }
+    }
+
+    void CheckWritable() const {
+        if (options_.readOnly) {
+            throw std::runtime_error("vector file is read-only");
+        }
+    }
+
+    /**
+     * @brief Ensures capacity for count more elements, growing geometrically.
+     */
+    void ReserveForAppend(size_t count) {
+        size_t size = Size();
+        if (size + count > Capacity()) {
+            ForceResize(std::max(Capacity() * 2, size + count));
+        }
+    }
+
+    /**
+     * @brief Grows the file to hold at least the given number of elements on
+     * behalf of a concurrent appender.
+     */
+    void GrowForConcurrentAppend(size_t needed) {
+        LockGuard lock(growth_mutex_);
+        if (Capacity() >= needed) {
+            return;
+        }
+        try {
+            ForceResize(std::max(Capacity() * 2, needed));
+        } catch (...) {
+            // Slots beyond capacity can never be published; release waiters
+            append_failed_.store(true, std::memory_order_relaxed);
+            throw;
+        }
+    }
+
+    /**
+     * @brief Sets the size of the backing file, allocating blocks for any
+     * growth if configured to.
+     */
+    void ResizeFile(size_t new_file_size) {
+#ifdef LIB_VECTOR_FILE_FALLOCATE
+        if (options_.fallocate && new_file_size > file_size_) {
+            if (posix_fallocate(fd_, static_cast<off_t>(file_size_), static_cast<off_t>(new_file_size - file_size_)) ==
+                0) {
+                return;
+            }
+            throw std::runtime_error("failed to resize file");
+        }
+#endif
+        if (ftruncate(fd_, static_cast<off_t>(new_file_size)) == 0) {
+            return;
+        }
+        throw std::runtime_error("failed to resize file");
+    }
+
+    int Protection() const { return options_.readOnly ? PROT_READ : PROT_READ | PROT_WRITE; }
+
+    static constexpr size_t RoundUpToPage(size_t bytes) { return (bytes + PageSize - 1) & ~(PageSize - 1); }
+
+    /**
+     * @brief Unit in which the file grows and the mapping is aligned.
+     */
+    size_t Granularity() const { return options_.hugePages ? HugePageSize : PageSize; }
+
+    size_t RoundUpToGranularity(size_t bytes) const { return (bytes + Granularity() - 1) & ~(Granularity() - 1); }
+
+    /**
+     * @brief Maps the page-aligned file range [offset, end) into memory.
+     * With a stable address, the range is placed at the same offset within
+     * the reservation; otherwise the whole file is mapped at a new address.
+     *
+     * @return Whether the mapping succeeded
+     */
+    bool MapRange(size_t offset, size_t end) {
+        if (StableAddress()) {
+            void* target = static_cast<char*>(mapped_) + offset;
+            void* result = mmap(target,
+                                end - offset,
+                                Protection(),
+                                MAP_SHARED | MAP_FIXED,
+                                fd_,
+                                static_cast<off_t>(offset));
+            if (result == MAP_FAILED) {
+                return false;
+            }
+        } else {
+            assert(offset == 0);
+            void* target = nullptr;
+            int flags = MAP_SHARED;
+            if (options_.hugePages) {
+                // Place the mapping on a huge page boundary
+                target = ReserveAddressSpace(end, HugePageSize);
+                if (target == nullptr) {
+                    mapped_ = nullptr;
+                    return false;
+                }
+                flags |= MAP_FIXED;
+            }
+            void* result = mmap(target, end, Protection(), flags, fd_, 0);
+            if (result == MAP_FAILED) {
+                if (target != nullptr) {
+                    munmap(target, end);
+                }
+                mapped_ = nullptr;
+                return false;
+            }
+            mapped_ = result;
+        }
+        if (options_.hugePages) {
+            AdviseHugePages(static_cast<char*>(mapped_) + offset, end - offset);
+        }
+        mapped_length_ = end;
+        return true;
+    }
+
     /**
      * @brief Forcibly resize the capacity of the vector to the next multiple of
-     * PageSize capable of holding new_capacity elements.
+     * PageSize (or HugePageSize) capable of holding new_capacity elements.
      *
      * @param new_capacity Minimum number of elements for capacity
      */
     void ForceResize(size_t new_capacity) {
-        if (mapped_ != nullptr) {
-            munmap(mapped_, file_size_);
+        // Round file size up to next multiple of a page (or huge page)
+        size_t new_file_size = RoundUpToGranularity(HeaderSpace + (new_capacity * sizeof(T)));
+
+        LockGuard lock(remap_mutex_);
+        bool snapshots = snapshots_enabled_.load(std::memory_order_relaxed);
+        if (snapshots && new_file_size < file_size_) {
+            // Snapshots may still read the tail
+            return;
         }
 
-        // Round file size up to next multiple of a page
-        size_t data_size = HeaderSpace + (new_capacity * sizeof(T));
-        size_t new_file_size = (data_size + PageSize - 1) & ~(PageSize - 1);
+        if (StableAddress()) {
+            ResizeInPlace(new_file_size);
+        } else if (snapshots) {
+            // Old mapping stays valid for its range since the file only grows;
+            // it is retired once no snapshot references it
+            ResizeFile(new_file_size);
+            void* old_mapped = mapped_;
+            if (!MapRange(0, new_file_size)) {
+                mapped_ = old_mapped;
+                throw std::runtime_error("failed to remap file after resize");
+            }
+            current_lease_.store(std::make_shared<const MappingLease>(mapped_, mapped_length_),
+                                 std::memory_order_release);
+        } else {
+            if (mapped_ != nullptr) {
+                munmap(mapped_, mapped_length_);
+                mapped_ = nullptr;
+            }
 
-        if (ftruncate(fd_, static_cast<off_t>(new_file_size)) == -1) {
-            throw std::runtime_error("failed to resize file");
-        }
+            ResizeFile(new_file_size);
 
-        mapped_ = mmap(nullptr, new_file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
-        if (mapped_ == MAP_FAILED) {
-            throw std::runtime_error("failed to remap file after resize");
+            if (!MapRange(0, new_file_size)) {
+                throw std::runtime_error("failed to remap file after resize");
+            }
         }
 
         // Compute new capacity based on rounded file size
@@ -247,27 +1047,78 @@ private:
         size_t adjusted_capacity = available_space / sizeof(T);
 
         file_size_ = new_file_size;
-        capacity_ = adjusted_capacity;
         Header()->capacity = adjusted_capacity;
+        capacity_.store(adjusted_capacity, std::memory_order_release);
+    }
+
+    /**
+     * @brief Resizes the backing file without moving the mapping. Growth maps
+     * only the new tail of the file; shrinking hands the tail back to the
+     * reservation.
+     *
+     * @param new_file_size Page-aligned new size of the backing file
+     */
+    void ResizeInPlace(size_t new_file_size) {
+        if (new_file_size > reserved_length_) {
+            throw std::length_error("vector file exceeds reserved address space");
+        }
+
+        if (new_file_size >= mapped_length_) {
+            ResizeFile(new_file_size);
+            if (new_file_size > mapped_length_ && !MapRange(mapped_length_, new_file_size)) {
+                throw std::runtime_error("failed to map file after resize");
+            }
+        } else {
+            void* tail = static_cast<char*>(mapped_) + new_file_size;
+            void* result = mmap(tail,
+                                mapped_length_ - new_file_size,
+                                PROT_NONE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED,
+                                -1,
+                                0);
+            if (result == MAP_FAILED) {
+                throw std::runtime_error("failed to release file tail");
+            }
+            mapped_length_ = new_file_size;
+            ResizeFile(new_file_size);
+        }
     }
 
+    VectorFileOptions options_;
+
     int fd_{-1};
     void* mapped_{nullptr};
     size_t file_size_{0};  // backing file size
 
-    size_t capacity_{0};  // vector capacity
-    size_t size_{0};      // vector size
+    size_t mapped_length_{0};    // page-aligned length of file mapping
+    size_t reserved_length_{0};  // reserved address space, if stable
+
+    std::atomic<size_t> capacity_{0};   // vector capacity
+    std::atomic<size_t> size_{0};       // vector size, published with release ordering
+    std::atomic<size_t> next_slot_{0};  // next slot for concurrent appenders
+    std::atomic<size_t> committed_{0};  // size as of last commit
+
+    std::atomic<bool> append_failed_{false};
+    core::Mutex growth_mutex_;  // serializes growth during concurrent appends
+    core::Mutex commit_mutex_;  // serializes commits
+
+    // Current mapping, shared with snapshots once any has been taken
+    mutable std::atomic<std::shared_ptr<const MappingLease>> current_lease_;
+    mutable std::atomic<bool> snapshots_enabled_{false};
+    mutable core::Mutex remap_mutex_;  // serializes remaps with enabling snapshots
+
+    bool recovered_torn_tail_{false};
 };
 
 // Alignment of int data -> 4 byte boundary
 static_assert(CustomVectorFile<int, int>::CustomDataSize == 4);
-static_assert(CustomVectorFile<int, int>::FileHeaderSpace == 16);
-static_assert(CustomVectorFile<int, int>::HeaderSpace == 20);
+static_assert(CustomVectorFile<int, int>::FileHeaderSpace == 56);
+static_assert(CustomVectorFile<int, int>::HeaderSpace == 60);
 
 // Alignment of long data -> 8 byte boundary
 static_assert(CustomVectorFile<long, int>::CustomDataSize == 4);
-static_assert(CustomVectorFile<long, int>::FileHeaderSpace == 16);
-static_assert(CustomVectorFile<long, int>::HeaderSpace == 24);
+static_assert(CustomVectorFile<long, int>::FileHeaderSpace == 56);
+static_assert(CustomVectorFile<long, int>::HeaderSpace == 64);
 
 template<typename T>
 using VectorFile = CustomVectorFile<T, void>;
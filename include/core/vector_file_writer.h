@@ -0,0 +1,235 @@
+#ifndef CORE_VECTOR_FILE_WRITER_H
+#define CORE_VECTOR_FILE_WRITER_H
+
+#include "core/mapping.h"
+#include "core/span.h"
+#include "core/vector_file.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace core {
+
+/**
+ * @brief Options for streaming a VectorFile out with CustomVectorFileWriter.
+ */
+struct VectorFileWriterOptions {
+    /**
+     * @brief Size of the user-space write buffer, rounded up to whole pages.
+     * Data reaches the file in writes of exactly this size.
+     */
+    size_t bufferBytes{8 * 1024 * 1024};
+
+    /**
+     * @brief Write with O_DIRECT, bypassing the page cache. Falls back to
+     * buffered writes on filesystems that do not support it.
+     */
+    bool directIO{false};
+
+    /**
+     * @brief fdatasync the data before publishing the header, and the header
+     * after, on close.
+     */
+    bool sync{true};
+
+    /**
+     * @brief Layout version recorded in the header. See
+     * VectorFileOptions::layoutVersion.
+     */
+    uint32_t layoutVersion{0};
+};
+
+/**
+ * @brief CustomVectorFileWriter builds a VectorFile in one pass without
+ * mapping it. Appends are collected in a page-aligned buffer and written out
+ * with pwrite, and the header is written last on Close, so the file only
+ * becomes a valid VectorFile once Close completes. The result opens with
+ * CustomVectorFile like any other.
+ *
+ * Meant for write-once files such as index segments, where the mapped write
+ * path pays a page fault and zero-fill on the first touch of every page.
+ * Any existing file at the path is truncated.
+ *
+ * @tparam T Vector element type
+ * @tparam CustomDataType Structure of custom data to be stored in file header.
+ * If void, no custom data will be stored.
+ */
+template<typename T, typename CustomDataType>
+class CustomVectorFileWriter {
+    using File = CustomVectorFile<T, CustomDataType>;
+    using FileHeader = typename File::FileHeader;
+    using CustomDataT = typename File::CustomDataT;
+
+public:
+    /**
+     * @brief Creates a writer for a new VectorFile at the given path.
+     *
+     * @param path Path of file to write
+     * @param options Buffering options
+     */
+    CustomVectorFileWriter(const char* path, VectorFileWriterOptions options = {})
+        : options_(options), buffer_bytes_(std::max(RoundUpToPage(options.bufferBytes), PageSize)) {
+        int flags = O_WRONLY | O_CREAT | O_TRUNC;
+        if (options.directIO) {
+            fd_ = open(path, flags | O_DIRECT, S_IRUSR | S_IWUSR);
+        }
+        if (fd_ == -1) {
+            fd_ = open(path, flags, S_IRUSR | S_IWUSR);
+        }
+        if (fd_ == -1) {
+            throw std::runtime_error("failed to open file");
+        }
+
+        buffer_ = static_cast<char*>(std::aligned_alloc(PageSize, buffer_bytes_));
+        if (buffer_ == nullptr) {
+            close(fd_);
+            throw std::bad_alloc();
+        }
+
+        // Header is written on close; reserve its space at the buffer start
+        std::memset(buffer_, 0, File::HeaderSpace);
+        buffered_ = File::HeaderSpace;
+    }
+
+    CustomVectorFileWriter(const CustomVectorFileWriter&) = delete;
+    CustomVectorFileWriter& operator=(const CustomVectorFileWriter&) = delete;
+
+    /**
+     * @brief Closes the file without completing it unless Close was called.
+     * The header of an abandoned file is never written, so it is not a valid
+     * VectorFile.
+     */
+    ~CustomVectorFileWriter() {
+        if (fd_ != -1) {
+            close(fd_);
+        }
+        std::free(buffer_);
+    }
+
+    size_t Size() const { return size_; }
+    bool Empty() const { return size_ == 0; }
+
+    /**
+     * @brief Gets a pointer to the custom data to store in the file header on
+     * close, if configured.
+     */
+    CustomDataT* CustomData() { return &custom_data_; }
+
+    /**
+     * @brief Appends the value to the end of the file.
+     *
+     * @param value Value to append
+     */
+    void PushBack(const T& value) { Append(core::Span<const T>{&value, 1}); }
+
+    /**
+     * @brief Appends a range of values to the end of the file.
+     *
+     * @param values Values to append
+     */
+    void Append(core::Span<const T> values) {
+        CheckOpen();
+        const char* bytes = reinterpret_cast<const char*>(values.Data());
+        size_t remaining = values.Size() * sizeof(T);
+        while (remaining > 0) {
+            size_t n = std::min(remaining, buffer_bytes_ - buffered_);
+            std::memcpy(buffer_ + buffered_, bytes, n);
+            buffered_ += n;
+            bytes += n;
+            remaining -= n;
+            if (buffered_ == buffer_bytes_) {
+                Flush(buffer_bytes_);
+            }
+        }
+        size_ += values.Size();
+    }
+
+    /**
+     * @brief Writes out buffered data and then the header, completing the
+     * file. Further appends throw std::runtime_error.
+     */
+    void Close() {
+        CheckOpen();
+
+        size_t file_size = RoundUpToPage(File::HeaderSpace + (std::max(size_, File::InitialCapacity) * sizeof(T)));
+
+        // Final write is padded to a page boundary, as O_DIRECT requires
+        size_t tail = RoundUpToPage(buffered_);
+        std::memset(buffer_ + buffered_, 0, tail - buffered_);
+        Flush(tail);
+        if (ftruncate(fd_, static_cast<off_t>(file_size)) == -1) {
+            throw std::runtime_error("failed to resize file");
+        }
+        if (options_.sync && fdatasync(fd_) == -1) {
+            throw std::runtime_error("failed to sync file");
+        }
+
+        // Header write is small and unaligned
+        int flags = fcntl(fd_, F_GETFL);
+        if (flags != -1 && (flags & O_DIRECT) != 0) {
+            fcntl(fd_, F_SETFL, flags & ~O_DIRECT);
+        }
+
+        std::memset(buffer_, 0, File::HeaderSpace);
+        FileHeader header = File::NewHeader(options_.layoutVersion);
+        header.capacity = (file_size - File::HeaderSpace) / sizeof(T);
+        header.size = size_;
+        header.checkpoint = size_;
+        header.checksum = 0;
+        std::memcpy(buffer_, &header, sizeof(header));
+        if constexpr (File::CustomDataSize != 0) {
+            std::memcpy(buffer_ + File::FileHeaderSpace, &custom_data_, File::CustomDataSize);
+        }
+        WriteAt(fd_, buffer_, File::HeaderSpace, 0);
+        if (options_.sync && fdatasync(fd_) == -1) {
+            throw std::runtime_error("failed to sync file");
+        }
+
+        close(fd_);
+        fd_ = -1;
+    }
+
+private:
+    static constexpr size_t RoundUpToPage(size_t bytes) { return (bytes + PageSize - 1) & ~(PageSize - 1); }
+
+    void CheckOpen() const {
+        if (fd_ == -1) {
+            throw std::runtime_error("vector file writer is closed");
+        }
+    }
+
+    /**
+     * @brief Writes the first length bytes of the buffer at the current file
+     * offset and empties the buffer.
+     */
+    void Flush(size_t length) {
+        WriteAt(fd_, buffer_, length, file_offset_);
+        file_offset_ += length;
+        buffered_ = 0;
+    }
+
+    VectorFileWriterOptions options_;
+    int fd_{-1};
+
+    char* buffer_{nullptr};
+    size_t buffer_bytes_;
+    size_t buffered_{0};     // bytes in buffer
+    size_t file_offset_{0};  // file offset of buffer start
+
+    size_t size_{0};
+    CustomDataT custom_data_{};
+};
+
+template<typename T>
+using VectorFileWriter = CustomVectorFileWriter<T, void>;
+
+}  // namespace core
+
+#endif
@@ -0,0 +1,152 @@
+/**
+ * @file windowed_mem_map_file.h
+ * @brief Read-only memory mapped file, mapped a window at a time
+ *
+ */
+
+#ifndef LIB_WINDOWED_MEM_MAP_FILE_H
+#define LIB_WINDOWED_MEM_MAP_FILE_H
+
+#include "core/lru_cache.h"
+#include "core/mem_map_file.h"
+#include "core/span.h"
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace core {
+
+struct WindowedMemMapFileOptions {
+    /**
+     * @brief Bytes of file each window starts after the previous one, rounded
+     * up to whole pages.
+     */
+    size_t windowSize{64 * 1024 * 1024};
+
+    /**
+     * @brief Bytes each window extends past the start of the next, rounded up
+     * to whole pages. Any range no longer than this lies within one window,
+     * so it can be viewed in place.
+     */
+    size_t windowOverlap{64 * 1024};
+
+    /**
+     * @brief Most windows mapped at once. Mapping another unmaps the least
+     * recently used. Bounds the mapped footprint to maxWindows *
+     * (windowSize + windowOverlap) bytes.
+     */
+    size_t maxWindows{16};
+};
+
+/**
+ * @brief WindowedMemMapFile reads a file through fixed-size windows mapped on
+ * demand, keeping at most a bounded number mapped, so files far larger than
+ * the memory budget can be served. Windows overlap by windowOverlap bytes,
+ * so ranges and records up to that size are viewed in place; longer ranges
+ * are copied out across window boundaries.
+ *
+ * Not safe for concurrent use: every access may unmap a window.
+ */
+class WindowedMemMapFile {
+public:
+    WindowedMemMapFile(const std::string& path, WindowedMemMapFileOptions options = {});
+
+    WindowedMemMapFile(const WindowedMemMapFile&) = delete;
+    WindowedMemMapFile& operator=(const WindowedMemMapFile&) = delete;
+
+    ~WindowedMemMapFile();
+
+    size_t size() const noexcept { return size_; }
+
+    /**
+     * @brief Number of windows currently mapped.
+     */
+    size_t MappedWindows() const { return windows_.Size(); }
+
+    /**
+     * @brief Views a range of the file in place. The view is valid until the
+     * next access.
+     *
+     * @param offset Offset of range in file
+     * @param length Length of range, at most windowOverlap
+     * @return core::Span<const char> Bytes of range
+     */
+    core::Span<const char> View(size_t offset, size_t length);
+
+    /**
+     * @brief Copies a range of the file out, across as many windows as it
+     * spans.
+     *
+     * @param offset Offset of range in file
+     * @param out Receives length bytes
+     * @param length Length of range
+     */
+    void Read(size_t offset, void* out, size_t length);
+
+    /**
+     * @brief Gets a record of a file laid out as an array of T, in place.
+     * The reference is valid until the next access.
+     *
+     * @param index Index of record
+     * @return const T& Record
+     */
+    template<typename T>
+        requires std::is_trivially_copyable_v<T>
+    const T& Record(size_t index) {
+        return *reinterpret_cast<const T*>(View(index * sizeof(T), sizeof(T)).Data());
+    }
+
+    /**
+     * @brief Copies consecutive records of a file laid out as an array of T.
+     *
+     * @param first Index of first record
+     * @param out Receives out.Size() records
+     */
+    template<typename T>
+        requires std::is_trivially_copyable_v<T>
+    void ReadRecords(size_t first, core::Span<T> out) {
+        Read(first * sizeof(T), out.Data(), out.Size() * sizeof(T));
+    }
+
+private:
+    /**
+     * @brief A mapped window, unmapped when evicted.
+     */
+    class Window {
+    public:
+        Window(const char* data, size_t length) : data_(data), length_(length) {}
+        Window(Window&& other) noexcept : data_(other.data_), length_(other.length_) { other.data_ = nullptr; }
+        Window& operator=(Window&&) = delete;
+        ~Window();
+
+        const char* Data() const { return data_; }
+        size_t Length() const { return length_; }
+
+    private:
+        const char* data_;
+        size_t length_;
+    };
+
+    /**
+     * @brief Gets a window, mapping it if needed.
+     */
+    const Window& MapWindow(size_t window);
+
+    void CheckRange(size_t offset, size_t length) const {
+        if (offset > size_ || length > size_ - offset) {
+            throw std::out_of_range("range past end of file");
+        }
+    }
+
+    int fd_{-1};
+    size_t size_{0};
+    size_t window_size_;
+    size_t window_overlap_;
+    core::LRUCache<size_t, Window> windows_;
+};
+
+}  // namespace core
+
+#endif
@@ -0,0 +1,118 @@
+/**
+ * @file mapping.cpp
+ * @brief Helpers shared by the memory-mapped data structures
+ *
+ */
+
+#include "core/mapping.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace core {
+
+size_t SystemPageSize() {
+    static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return page_size;
+}
+
+void WriteAt(int fd, const void* data, size_t length, size_t offset) {
+    const char* bytes = static_cast<const char*>(data);
+    while (length > 0) {
+        ssize_t written = pwrite(fd, bytes, length, static_cast<off_t>(offset));
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("failed to write file");
+        }
+        bytes += written;
+        length -= written;
+        offset += written;
+    }
+}
+
+void* ReserveAddressSpace(size_t length, size_t alignment) {
+    // Over-reserve so an aligned start exists, then trim the excess
+    size_t padded = length + alignment;
+    void* raw = mmap(nullptr, padded, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (raw == MAP_FAILED) {
+        return nullptr;
+    }
+
+    auto start = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t aligned = (start + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+    size_t head = aligned - start;
+    size_t tail = padded - head - length;
+    if (head != 0) {
+        munmap(raw, head);
+    }
+    if (tail != 0) {
+        munmap(reinterpret_cast<void*>(aligned + length), tail);
+    }
+    return reinterpret_cast<void*>(aligned);
+}
+
+void AdviseHugePages(void* addr, size_t length) {
+#ifdef MADV_HUGEPAGE
+    madvise(addr, length, MADV_HUGEPAGE);
+#else
+    (void)addr;
+    (void)length;
+#endif
+}
+
+size_t HugePageBackedBytes(const void* addr, size_t length) {
+    FILE* smaps = fopen("/proc/self/smaps", "r");
+    if (smaps == nullptr) {
+        return 0;
+    }
+
+    auto begin = reinterpret_cast<uintptr_t>(addr);
+    uintptr_t end = begin + length;
+
+    double total = 0;
+    double overlap_fraction = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), smaps) != nullptr) {
+        uintptr_t vma_begin = 0;
+        uintptr_t vma_end = 0;
+        if (sscanf(line, "%lx-%lx ", &vma_begin, &vma_end) == 2) {
+            // Header line of a new mapping
+            uintptr_t lo = std::max(begin, vma_begin);
+            uintptr_t hi = std::min(end, vma_end);
+            overlap_fraction =
+                hi > lo ? static_cast<double>(hi - lo) / static_cast<double>(vma_end - vma_begin) : 0;
+            continue;
+        }
+        if (overlap_fraction == 0) {
+            continue;
+        }
+
+        size_t kb = 0;
+        if (sscanf(line, "AnonHugePages: %zu kB", &kb) == 1 || sscanf(line, "ShmemPmdMapped: %zu kB", &kb) == 1 ||
+            sscanf(line, "FilePmdMapped: %zu kB", &kb) == 1) {
+            total += static_cast<double>(kb) * 1024 * overlap_fraction;
+        }
+    }
+
+    fclose(smaps);
+    return static_cast<size_t>(total);
+}
+
+bool PageResidency(const void* addr, size_t length, unsigned char* resident) {
+    size_t pages = (length + SystemPageSize() - 1) / SystemPageSize();
+    if (mincore(const_cast<void*>(addr), length, resident) == -1) {
+        std::memset(resident, 0, pages);
+        return false;
+    }
+    return true;
+}
+
+}  // namespace core
@@ -11,15 +11,59 @@
 
 #include "core/mem_map_file.h"
 
+#include "core/locks.h"
+#include "core/mapping.h"
+
+#include <algorithm>
 #include <fcntl.h>
 #include <string>
 #include <sys/mman.h>
 #include <unistd.h>
-#include <iostream>
 
 namespace core {
 
-MemMapFile::MemMapFile(const std::string& path, bool forceInMemory) {
+namespace {
+
+// Unit of warm-up work claimed by one thread at a time
+constexpr size_t PrefaultChunkSize = 4 * 1024 * 1024;
+
+/**
+ * @brief Asks the kernel to fault in a range of the mapping.
+ *
+ * @return Whether the range was populated; false where MADV_POPULATE_READ is
+ * unsupported
+ */
+bool PopulateRange(char* begin, size_t length) {
+#ifdef MADV_POPULATE_READ
+    return madvise(begin, length, MADV_POPULATE_READ) == 0;
+#else
+    (void)begin;
+    (void)length;
+    return false;
+#endif
+}
+
+/**
+ * @brief Locks a mapping in memory, as pages are faulted in where the system
+ * supports it.
+ */
+bool LockMapping(const char* data, size_t length) {
+#ifdef MLOCK_ONFAULT
+    // Lock pages as they are faulted in rather than all at once, so locking
+    // does not itself hold up an asynchronous warm-up
+    if (mlock2(data, length, MLOCK_ONFAULT) == 0) {
+        return true;
+    }
+#endif
+    return mlock(data, length) == 0;
+}
+
+}  // namespace
+
+MemMapFile::MemMapFile(const std::string& path, bool forceInMemory)
+    : MemMapFile(path, MemMapFileOptions{.forceInMemory = forceInMemory}) {}
+
+MemMapFile::MemMapFile(const std::string& path, MemMapFileOptions options) {
     fd_ = open(path.c_str(), O_RDONLY);
     if (fd_ == -1) {
         throw FileOpenFailure(path, "bad fd");
@@ -37,29 +81,113 @@ MemMapFile::MemMapFile(const std::string& path, bool forceInMemory) {
         throw FileOpenFailure(path, "size zero");
     }
 
-    data_ = static_cast<char*>(mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0));
+    void* target = nullptr;
+    int flags = MAP_PRIVATE;
+    mapped_length_ = size_;
+    if (options.hugePages) {
+        // Place the mapping on a huge page boundary
+        mapped_length_ = (size_ + HugePageSize - 1) & ~(HugePageSize - 1);
+        target = ReserveAddressSpace(mapped_length_, HugePageSize);
+        if (target == nullptr) {
+            close(fd_);
+            throw FileOpenFailure(path, "address space reservation failed");
+        }
+        flags |= MAP_FIXED;
+    }
+
+    data_ = static_cast<char*>(mmap(target, size_, PROT_READ, flags, fd_, 0));
 
     if (data_ == MAP_FAILED) {
+        if (target != nullptr) {
+            munmap(target, mapped_length_);
+        }
         close(fd_);
         throw FileOpenFailure(path, "mmap() failed");
     }
 
-    if (forceInMemory) {
-        if (mlock(data_, size_) != 0) {
-            std::cout << "unable to mlock " << path;
+    if (options.hugePages) {
+        AdviseHugePages(const_cast<char*>(data_), size_);
+    }
+
+    if (!options.forceInMemory) {
+        return;
+    }
+
+    locked_ = LockMapping(data_, size_);
+
+    pending_chunks_.store((size_ + PrefaultChunkSize - 1) / PrefaultChunkSize, std::memory_order_relaxed);
+    size_t threads = std::max<size_t>(options.prefaultThreads, 1);
+    // Reserved up front so that adding a started thread cannot throw
+    warmers_.reserve(threads);
+    try {
+        for (size_t i = options.asyncPrefault ? 0 : 1; i < threads; i++) {
+            warmers_.push_back(core::Thread([this, prefault = options.prefault] { PrefaultChunks(prefault); }));
+        }
+    } catch (...) {
+        stop_.store(true, std::memory_order_relaxed);
+        WaitForWarmup();
+        munmap(const_cast<char*>(data_), mapped_length_);
+        close(fd_);
+        throw;
+    }
+    if (!options.asyncPrefault) {
+        PrefaultChunks(options.prefault);
+        WaitForWarmup();
+    }
+}
+
+void MemMapFile::PrefaultChunks(Prefault prefault) {
+    while (!stop_.load(std::memory_order_relaxed)) {
+        size_t begin = next_chunk_.fetch_add(1, std::memory_order_relaxed) * PrefaultChunkSize;
+        if (begin >= size_) {
+            return;
         }
 
-        // Touch all pages to force in memory
-        volatile char tmp;
-        for (size_t i = 0; i < size_; i += 4096) {
-            tmp = *((char*)data_ + i);
+        size_t length = std::min(PrefaultChunkSize, size_ - begin);
+        char* chunk = const_cast<char*>(data_) + begin;
+        if (prefault != Prefault::Populate || !PopulateRange(chunk, length)) {
+            // Touch a byte of every page to fault it in
+            size_t page_size = SystemPageSize();
+            volatile char sink;
+            for (size_t i = 0; i < length; i += page_size) {
+                sink = chunk[i];
+            }
+            (void)sink;
         }
+        prefaulted_.fetch_add(length, std::memory_order_relaxed);
+        pending_chunks_.fetch_sub(1, std::memory_order_release);
     }
 }
 
+void MemMapFile::WaitForWarmup() {
+    LockGuard lock(warmers_mutex_);
+    for (auto& warmer : warmers_) {
+        if (warmer.Joinable()) {
+            warmer.Join();
+        }
+    }
+    warmers_.clear();
+}
+
+double MemMapFile::ResidentFraction() const {
+    size_t pages = (size_ + SystemPageSize() - 1) / SystemPageSize();
+    core::Vector<unsigned char> resident(pages);
+    PageResidency(data_, size_, resident.data());
+    size_t count = std::count_if(resident.begin(), resident.end(), [](unsigned char page) { return (page & 1) != 0; });
+    return static_cast<double>(count) / static_cast<double>(pages);
+}
+
+size_t MemMapFile::HugePageBytes() const {
+    return HugePageBackedBytes(data_, size_);
+}
+
 MemMapFile::~MemMapFile() {
+    // Warm-up threads must be gone before the mapping is
+    stop_.store(true, std::memory_order_relaxed);
+    WaitForWarmup();
+
     if (data_ && data_ != MAP_FAILED)
-        munmap(const_cast<char*>(data_), size_);
+        munmap(const_cast<char*>(data_), mapped_length_);
 
     if (fd_ != -1)
         close(fd_);
@@ -0,0 +1,155 @@
+/**
+ * @file section_file.cpp
+ * @brief Self-describing file of typed sections, read in place through a
+ * MemMapFile
+ *
+ */
+
+#include "core/section_file.h"
+
+#include "core/checksum.h"
+#include "core/mapping.h"
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace core {
+
+namespace {
+
+constexpr size_t AlignSection(size_t offset) {
+    return (offset + internal::SectionAlignment - 1) & ~(internal::SectionAlignment - 1);
+}
+
+}  // namespace
+
+SectionFile::SectionFile(const std::string& path, uint32_t version, SectionFileOptions options)
+    : file_(path, options.map) {
+    if (file_.size() < sizeof(internal::SectionFileHeader)) {
+        throw FileOpenFailure(path, "too small for section file header");
+    }
+
+    const internal::SectionFileHeader* header = Header();
+    if (header->magic != internal::SectionFileMagic) {
+        throw FileOpenFailure(path, "not a section file");
+    }
+    if (header->formatVersion != internal::SectionFileFormatVersion) {
+        throw FileOpenFailure(path, "unsupported section file format " + std::to_string(header->formatVersion));
+    }
+    if (header->version != version) {
+        throw FileOpenFailure(path,
+                              "section file version " + std::to_string(header->version) + ", expected " +
+                                  std::to_string(version));
+    }
+
+    size_t table_bytes = header->sectionCount * sizeof(internal::SectionEntry);
+    if (header->tableOffset % alignof(internal::SectionEntry) != 0 || header->tableOffset > file_.size() ||
+        header->sectionCount > file_.size() / sizeof(internal::SectionEntry) ||
+        table_bytes > file_.size() - header->tableOffset) {
+        throw FileOpenFailure(path, "section table out of bounds");
+    }
+    table_ = reinterpret_cast<const internal::SectionEntry*>(file_.data() + header->tableOffset);
+    if (Checksum64(table_, table_bytes, header->sectionCount) != header->tableChecksum) {
+        throw FileOpenFailure(path, "section table checksum mismatch");
+    }
+
+    for (size_t i = 0; i < header->sectionCount; i++) {
+        const internal::SectionEntry& entry = table_[i];
+        if (entry.offset % internal::SectionAlignment != 0 || entry.offset > file_.size() ||
+            entry.size > file_.size() - entry.offset || entry.elementSize == 0 ||
+            entry.size % entry.elementSize != 0) {
+            throw FileOpenFailure(path, "section " + std::to_string(entry.id) + " out of bounds");
+        }
+        if (options.verifyChecksums &&
+            Checksum64(file_.data() + entry.offset, entry.size, entry.id) != entry.checksum) {
+            throw FileOpenFailure(path, "section " + std::to_string(entry.id) + " checksum mismatch");
+        }
+    }
+}
+
+core::Span<const char> SectionFile::Bytes(uint32_t id) const {
+    const internal::SectionEntry& entry = Get(id);
+    return core::Span<const char>{file_.data() + entry.offset, entry.size};
+}
+
+const internal::SectionEntry* SectionFile::Find(uint32_t id) const {
+    for (size_t i = 0; i < Header()->sectionCount; i++) {
+        if (table_[i].id == id) {
+            return &table_[i];
+        }
+    }
+    return nullptr;
+}
+
+SectionFileWriter::SectionFileWriter(const std::string& path, uint32_t version)
+    : version_(version), end_(AlignSection(sizeof(internal::SectionFileHeader))) {
+    fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd_ == -1) {
+        throw std::runtime_error("failed to open file");
+    }
+}
+
+SectionFileWriter::~SectionFileWriter() {
+    // Without Close the header is never written, so an abandoned file is not
+    // a valid section file
+    if (fd_ != -1) {
+        close(fd_);
+    }
+}
+
+void SectionFileWriter::AddSection(uint32_t id,
+                                   const void* data,
+                                   size_t size,
+                                   uint32_t element_size,
+                                   internal::SectionKind kind) {
+    CheckOpen();
+    for (const auto& entry : table_) {
+        if (entry.id == id) {
+            throw std::invalid_argument("duplicate section id");
+        }
+    }
+
+    WriteAt(fd_, data, size, end_);
+    table_.push_back(internal::SectionEntry{
+        .id = id,
+        .elementSize = element_size,
+        .offset = end_,
+        .size = size,
+        .checksum = Checksum64(data, size, id),
+        .kind = kind,
+        .reserved = 0,
+    });
+    end_ = AlignSection(end_ + size);
+}
+
+void SectionFileWriter::Close() {
+    CheckOpen();
+
+    size_t table_bytes = table_.size() * sizeof(internal::SectionEntry);
+    WriteAt(fd_, table_.data(), table_bytes, end_);
+    if (ftruncate(fd_, static_cast<off_t>(end_ + table_bytes)) == -1) {
+        throw std::runtime_error("failed to resize file");
+    }
+    if (fdatasync(fd_) == -1) {
+        throw std::runtime_error("failed to sync file");
+    }
+
+    internal::SectionFileHeader header{
+        .magic = internal::SectionFileMagic,
+        .formatVersion = internal::SectionFileFormatVersion,
+        .version = version_,
+        .sectionCount = table_.size(),
+        .tableOffset = end_,
+        .tableChecksum = Checksum64(table_.data(), table_bytes, table_.size()),
+    };
+    WriteAt(fd_, &header, sizeof(header), 0);
+    if (fdatasync(fd_) == -1) {
+        throw std::runtime_error("failed to sync file");
+    }
+
+    close(fd_);
+    fd_ = -1;
+}
+
+}  // namespace core
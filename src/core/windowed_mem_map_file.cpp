@@ -0,0 +1,106 @@
+/**
+ * @file windowed_mem_map_file.cpp
+ * @brief Read-only memory mapped file, mapped a window at a time
+ *
+ */
+
+#include "core/windowed_mem_map_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace core {
+
+namespace {
+
+// Window offsets must be multiples of the kernel's page size, which is not
+// 4 KiB everywhere
+size_t WindowPageSize() {
+    static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return page_size;
+}
+
+size_t RoundUpToPage(size_t bytes) {
+    return (bytes + WindowPageSize() - 1) & ~(WindowPageSize() - 1);
+}
+
+}  // namespace
+
+WindowedMemMapFile::WindowedMemMapFile(const std::string& path, WindowedMemMapFileOptions options)
+    : window_size_(std::max(RoundUpToPage(options.windowSize), WindowPageSize())),
+      window_overlap_(RoundUpToPage(options.windowOverlap)),
+      windows_(options.maxWindows) {
+    fd_ = open(path.c_str(), O_RDONLY);
+    if (fd_ == -1) {
+        throw FileOpenFailure(path, "bad fd");
+    }
+
+    off_t len = lseek(fd_, 0, SEEK_END);
+    if (len == -1) {
+        close(fd_);
+        throw FileOpenFailure(path, "bad length");
+    }
+    size_ = static_cast<size_t>(len);
+}
+
+WindowedMemMapFile::~WindowedMemMapFile() {
+    if (fd_ != -1) {
+        close(fd_);
+    }
+}
+
+WindowedMemMapFile::Window::~Window() {
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), length_);
+    }
+}
+
+core::Span<const char> WindowedMemMapFile::View(size_t offset, size_t length) {
+    CheckRange(offset, length);
+    if (length > window_overlap_) {
+        throw std::length_error("view longer than window overlap");
+    }
+    if (length == 0) {
+        return {};
+    }
+
+    size_t window = offset / window_size_;
+    const Window& mapped = MapWindow(window);
+    return core::Span<const char>{mapped.Data() + (offset - (window * window_size_)), length};
+}
+
+void WindowedMemMapFile::Read(size_t offset, void* out, size_t length) {
+    CheckRange(offset, length);
+    char* dest = static_cast<char*>(out);
+    while (length > 0) {
+        size_t window = offset / window_size_;
+        const Window& mapped = MapWindow(window);
+        size_t within = offset - (window * window_size_);
+        // Copy up to the next window's start, leaving the overlap to it
+        size_t n = std::min(length, std::min(window_size_, mapped.Length()) - within);
+        std::memcpy(dest, mapped.Data() + within, n);
+        dest += n;
+        offset += n;
+        length -= n;
+    }
+}
+
+const WindowedMemMapFile::Window& WindowedMemMapFile::MapWindow(size_t window) {
+    if (auto* found = windows_.Find(window)) {
+        return found->second;
+    }
+
+    size_t begin = window * window_size_;
+    size_t length = std::min(window_size_ + window_overlap_, size_ - begin);
+    void* data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd_, static_cast<off_t>(begin));
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("failed to map file window");
+    }
+
+    return windows_.Insert({window, Window{static_cast<const char*>(data), length}}).first->second;
+}
+
+}  // namespace core
@@ -0,0 +1,167 @@
+#include "core/buffered_ordered_map_file.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <gtest/gtest.h>
+
+using namespace core;
+
+namespace {
+
+constexpr const char* BufferedMapFileName = "buffered_ordered_map.dat";
+constexpr const char* BufferedMapLogName = "buffered_ordered_map.dat.log";
+
+class BufferedOrderedMapFileTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::filesystem::remove(BufferedMapFileName);
+        std::filesystem::remove(BufferedMapLogName);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove(BufferedMapFileName);
+        std::filesystem::remove(BufferedMapLogName);
+    }
+};
+
+using BufferedMap = BufferedOrderedMapFile<uint64_t, uint64_t, 16, NaturalOrder>;
+
+}  // namespace
+
+TEST_F(BufferedOrderedMapFileTest, MatchesReferenceAcrossMerges) {
+    std::mt19937_64 rng(11);
+    std::map<uint64_t, uint64_t> reference;
+    BufferedMap map(BufferedMapFileName, NaturalOrder{}, 500);
+
+    for (uint64_t i = 0; i < 20000; i++) {
+        uint64_t key = rng() % 8000;
+        switch (rng() % 4) {
+        case 0:
+            map.Erase(key);
+            reference.erase(key);
+            break;
+        case 1:
+            EXPECT_EQ(map.Insert(key, i), !reference.contains(key));
+            reference.emplace(key, i);
+            break;
+        default:
+            map.InsertOrAssign(key, i);
+            reference[key] = i;
+            break;
+        }
+        ASSERT_LT(map.Buffered(), 500);
+    }
+
+    for (uint64_t key = 0; key < 8000; key++) {
+        auto found = map.Find(key);
+        auto expected = reference.find(key);
+        ASSERT_EQ(found.HasValue(), expected != reference.end()) << key;
+        if (found) {
+            EXPECT_EQ(*found, expected->second);
+        }
+        EXPECT_EQ(map.Contains(key), expected != reference.end());
+    }
+
+    map.Flush();
+    EXPECT_EQ(map.Buffered(), 0);
+    EXPECT_EQ(map.Merged().Size(), reference.size());
+    auto it = reference.begin();
+    for (auto [key, value] : map.Merged()) {
+        ASSERT_NE(it, reference.end());
+        EXPECT_EQ(*key, it->first);
+        EXPECT_EQ(*value, it->second);
+        ++it;
+    }
+    EXPECT_EQ(it, reference.end());
+}
+
+TEST_F(BufferedOrderedMapFileTest, ReplaysLogOnReopen) {
+    {
+        BufferedMap map(BufferedMapFileName, NaturalOrder{}, 100);
+        for (uint64_t i = 0; i < 250; i++) {
+            map.InsertOrAssign(i, i * 2);
+        }
+        map.Erase(3);
+        map.Erase(240);
+        EXPECT_GT(map.Buffered(), 0);
+        EXPECT_TRUE(map.Merged().Contains(3));
+    }
+
+    // Unmerged writes are recovered from the log
+    BufferedMap map(BufferedMapFileName, NaturalOrder{}, 100);
+    EXPECT_GT(map.Buffered(), 0);
+    for (uint64_t i = 0; i < 250; i++) {
+        if (i == 3 || i == 240) {
+            EXPECT_FALSE(map.Contains(i));
+        } else {
+            ASSERT_TRUE(map.Find(i).HasValue()) << i;
+            EXPECT_EQ(*map.Find(i), i * 2);
+        }
+    }
+
+    map.Flush();
+    EXPECT_EQ(map.Merged().Size(), 248);
+    EXPECT_EQ(map.Buffered(), 0);
+
+    // Merged writes leave nothing to replay
+    BufferedMap reopened(BufferedMapFileName, NaturalOrder{}, 100);
+    EXPECT_EQ(reopened.Buffered(), 0);
+    EXPECT_EQ(reopened.Merged().Size(), 248);
+}
+
+TEST_F(BufferedOrderedMapFileTest, ExplicitCommitSurvivesCrash) {
+    constexpr const char* CrashedName = "buffered_ordered_map_crashed.dat";
+    constexpr const char* CrashedLogName = "buffered_ordered_map_crashed.dat.log";
+    VectorFileOptions options{.durability = Durability::Explicit};
+    {
+        BufferedMap map(BufferedMapFileName, NaturalOrder{}, 100, options);
+        for (uint64_t i = 0; i < 150; i++) {
+            map.InsertOrAssign(i, i + 1);
+        }
+        map.Commit();
+        map.InsertOrAssign(1000, 1);
+
+        // Copy the files as a crash would leave them: committed log records
+        // and merged, synced tree pages only
+        std::filesystem::copy_file(
+            BufferedMapFileName, CrashedName, std::filesystem::copy_options::overwrite_existing);
+        std::filesystem::copy_file(
+            BufferedMapLogName, CrashedLogName, std::filesystem::copy_options::overwrite_existing);
+    }
+
+    {
+        BufferedMap crashed(CrashedName, NaturalOrder{}, 100, options);
+        EXPECT_EQ(crashed.Merged().Size(), 100);
+        for (uint64_t i = 0; i < 150; i++) {
+            ASSERT_TRUE(crashed.Find(i).HasValue()) << i;
+            EXPECT_EQ(*crashed.Find(i), i + 1);
+        }
+        EXPECT_FALSE(crashed.Contains(1000));
+    }
+    std::filesystem::remove(CrashedName);
+    std::filesystem::remove(CrashedLogName);
+}
+
+TEST_F(BufferedOrderedMapFileTest, HotKeysBoundTheLog) {
+    BufferedMap map(BufferedMapFileName, NaturalOrder{}, 100);
+
+    // Rewriting a handful of keys never fills the buffer, so only the log
+    // bound triggers merges
+    for (uint64_t i = 0; i < 10000; i++) {
+        map.InsertOrAssign(i % 4, i);
+        ASSERT_LE(map.Buffered(), 4);
+    }
+    // The last merge happened within the last 200 writes
+    ASSERT_EQ(map.Merged().Size(), 4);
+    auto merged = map.Merged().Find(0);
+    ASSERT_TRUE(merged.HasValue());
+    EXPECT_GE(*merged->value, 10000 - 200);
+
+    for (uint64_t key = 0; key < 4; key++) {
+        auto found = map.Find(key);
+        ASSERT_TRUE(found.HasValue());
+        EXPECT_EQ(*found, 9996 + key);
+    }
+}
@@ -0,0 +1,161 @@
+#include "core/compressed_vector_file.h"
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace core;
+
+namespace {
+
+constexpr const char* CompressedFileName = "compressed_vector_file.dat";
+constexpr const char* CompressedBlocksFileName = "compressed_vector_file.dat.blocks";
+
+class CompressedVectorFileTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::filesystem::remove(CompressedFileName);
+        std::filesystem::remove(CompressedBlocksFileName);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove(CompressedFileName);
+        std::filesystem::remove(CompressedBlocksFileName);
+    }
+};
+
+}  // namespace
+
+TEST_F(CompressedVectorFileTest, EmptyFile) {
+    CompressedVectorFile<uint32_t> file(CompressedFileName);
+    EXPECT_TRUE(file.Empty());
+    EXPECT_EQ(file.begin(), file.end());
+    EXPECT_THROW(file[0], std::out_of_range);
+}
+
+TEST_F(CompressedVectorFileTest, MonotoneRandomAccessAndIteration) {
+    std::vector<uint32_t> expected;
+    uint32_t value = 7;
+    for (size_t i = 0; i < 1000; ++i) {
+        value += static_cast<uint32_t>((i * 37) % 100);
+        expected.push_back(value);
+    }
+
+    CompressedVectorFile<uint32_t> file(CompressedFileName);
+    file.Append(core::Span<const uint32_t>{expected.data(), expected.size()});
+    ASSERT_EQ(file.Size(), expected.size());
+
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(file[i], expected[i]) << "index " << i;
+    }
+
+    size_t i = 0;
+    for (uint32_t v : file) {
+        ASSERT_LT(i, expected.size());
+        EXPECT_EQ(v, expected[i]) << "index " << i;
+        ++i;
+    }
+    EXPECT_EQ(i, expected.size());
+
+    // Gaps under 128 pack to 7 bits, well under a quarter of raw size
+    EXPECT_LT(file.CompressedBytes(), expected.size() * sizeof(uint32_t) / 3);
+}
+
+TEST_F(CompressedVectorFileTest, UnsortedAndWideValues) {
+    std::vector<uint64_t> expected;
+    for (size_t i = 0; i < 600; ++i) {
+        if (i < 256) {
+            expected.push_back((i * 7919) % 1000);
+        } else if (i < 384) {
+            expected.push_back(42);  // Constant block packs to zero bits
+        } else {
+            expected.push_back(i % 2 == 0 ? UINT64_MAX - i : i);
+        }
+    }
+
+    {
+        CompressedVectorFile<uint64_t> file(CompressedFileName);
+        for (uint64_t v : expected) {
+            file.PushBack(v);
+        }
+    }
+
+    CompressedVectorFile<uint64_t> file(CompressedFileName);
+    ASSERT_EQ(file.Size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(file[i], expected[i]) << "index " << i;
+    }
+
+    std::vector<uint64_t> decoded(file.begin(), file.end());
+    EXPECT_EQ(decoded, expected);
+}
+
+TEST_F(CompressedVectorFileTest, ReadOnlyRejectsAppends) {
+    {
+        CompressedVectorFile<uint32_t> file(CompressedFileName);
+        for (uint32_t i = 0; i < 300; ++i) {
+            file.PushBack(i);
+        }
+    }
+    CompressedVectorFile<uint32_t> file(CompressedFileName, VectorFileOptions{.readOnly = true});
+    EXPECT_TRUE(file.ReadOnly());
+    EXPECT_THROW(file.PushBack(1), std::runtime_error);
+    uint32_t values[] = {1, 2};
+    EXPECT_THROW(file.Append(core::Span<const uint32_t>{values, 2}), std::runtime_error);
+    ASSERT_EQ(file.Size(), 300);
+    EXPECT_EQ(file[299], 299);
+}
+
+TEST_F(CompressedVectorFileTest, ReconcilesFilesAfterCrash) {
+    constexpr const char* SavedFileName = "compressed_vector_file.saved";
+    {
+        CompressedVectorFile<uint32_t> file(CompressedFileName);
+        for (uint32_t i = 0; i < 255; ++i) {
+            file.PushBack(i * 2);
+        }
+    }
+    std::filesystem::copy_file(CompressedFileName, SavedFileName, std::filesystem::copy_options::overwrite_existing);
+    {
+        CompressedVectorFile<uint32_t> file(CompressedFileName);
+        file.PushBack(510);
+    }
+
+    // Crash after the index grew but before the size did: the extra block
+    // is trimmed and the tail it was flushed from is still there
+    std::filesystem::copy_file(SavedFileName, CompressedFileName, std::filesystem::copy_options::overwrite_existing);
+    {
+        CompressedVectorFile<uint32_t> file(CompressedFileName);
+        ASSERT_EQ(file.Size(), 255);
+        EXPECT_EQ(file[254], 508);
+        file.PushBack(510);
+        file.PushBack(512);
+    }
+    {
+        CompressedVectorFile<uint32_t> file(CompressedFileName);
+        ASSERT_EQ(file.Size(), 257);
+        for (uint32_t i = 0; i < 257; ++i) {
+            ASSERT_EQ(file[i], i * 2);
+        }
+    }
+
+    // An index missing a block the size counts cannot be repaired
+    std::filesystem::copy_file(CompressedBlocksFileName, SavedFileName, std::filesystem::copy_options::overwrite_existing);
+    {
+        CompressedVectorFile<uint32_t> file(CompressedFileName);
+        for (uint32_t i = 257; i < 400; ++i) {
+            file.PushBack(i * 2);
+        }
+    }
+    std::filesystem::copy_file(SavedFileName, CompressedBlocksFileName, std::filesystem::copy_options::overwrite_existing);
+    EXPECT_THROW(CompressedVectorFile<uint32_t>{CompressedFileName}, std::runtime_error);
+    std::filesystem::remove(SavedFileName);
+}
+
+TEST_F(CompressedVectorFileTest, RejectsOtherLayouts) {
+    // Same word and metadata sizes, but no layout version recorded
+    constexpr size_t MetadataBytes = sizeof(uint64_t) + (CompressedVectorFile<uint32_t>::BlockSize * sizeof(uint32_t));
+    CustomVectorFile<uint64_t, std::array<char, MetadataBytes>>(CompressedFileName).PushBack(0);
+    EXPECT_THROW(CompressedVectorFile<uint32_t>{CompressedFileName}, std::runtime_error);
+}
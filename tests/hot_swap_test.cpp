@@ -0,0 +1,144 @@
+#include "core/hot_swap.h"
+#include "core/mem_map_file.h"
+#include "core/thread.h"
+#include "core/vector.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sched.h>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+
+using core::HotSwap;
+using core::MemMapFile;
+using core::MemMapFileOptions;
+
+namespace {
+
+class HotSwapTest : public ::testing::Test {
+protected:
+    static constexpr size_t Words = 4096;
+    static constexpr size_t Versions = 4;
+
+    core::Vector<fs::path> paths_;
+
+    void SetUp() override {
+        // Each version is a file filled with its version number
+        for (size_t v = 0; v < Versions; v++) {
+            fs::path path = fs::temp_directory_path() / ("hot_swap_test_file_" + std::to_string(v));
+            std::vector<uint64_t> words(Words, v);
+            std::ofstream out(path, std::ios::binary);
+            out.write(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(uint64_t));
+            paths_.push_back(path);
+        }
+    }
+
+    void TearDown() override {
+        for (const auto& path : paths_) {
+            fs::remove(path);
+        }
+    }
+
+    static std::unique_ptr<MemMapFile> Open(const fs::path& path) {
+        return std::make_unique<MemMapFile>(path.string(), MemMapFileOptions{.forceInMemory = false});
+    }
+};
+
+}  // namespace
+
+TEST_F(HotSwapTest, AcquireSeesCurrentVersion) {
+    HotSwap<MemMapFile> index(Open(paths_[0]));
+    EXPECT_EQ(index.Generation(), 0);
+    EXPECT_EQ(reinterpret_cast<const uint64_t*>(index.Acquire()->data())[0], 0);
+
+    index.Reload(Open(paths_[1]));
+    EXPECT_EQ(index.Generation(), 1);
+    EXPECT_EQ(reinterpret_cast<const uint64_t*>(index.Acquire()->data())[0], 1);
+
+    index.Emplace(paths_[2].string(), MemMapFileOptions{.forceInMemory = false});
+    EXPECT_EQ(index.Generation(), 2);
+    auto pin = index.Acquire();
+    EXPECT_EQ(pin->size(), Words * sizeof(uint64_t));
+    EXPECT_EQ(reinterpret_cast<const uint64_t*>(pin->data())[Words - 1], 2);
+}
+
+TEST_F(HotSwapTest, PinOutlivesPublish) {
+    HotSwap<MemMapFile> index(Open(paths_[0]));
+    auto pin = index.Acquire();
+
+    // The reload publishes at once but cannot unmap version 0 until the pin
+    // is released
+    std::atomic<bool> reloaded{false};
+    core::Thread reloader([&] {
+        index.Reload(Open(paths_[1]));
+        reloaded = true;
+    });
+
+    while (index.Generation() == 0) {
+    }
+    EXPECT_EQ(reinterpret_cast<const uint64_t*>(index.Acquire()->data())[0], 1);
+    EXPECT_FALSE(reloaded.load());
+    EXPECT_EQ(reinterpret_cast<const uint64_t*>(pin->data())[0], 0);
+
+    { auto released = std::move(pin); }
+    reloader.Join();
+    EXPECT_TRUE(reloaded.load());
+}
+
+TEST_F(HotSwapTest, ConcurrentReadersDuringReloads) {
+    constexpr size_t Readers = 4;
+    constexpr size_t Reloads = 200;
+
+    HotSwap<MemMapFile> index(Open(paths_[0]));
+    std::atomic<bool> done{false};
+    std::atomic<size_t> torn{0};
+    std::atomic<size_t> reads{0};
+
+    core::Vector<core::Thread> readers;
+    for (size_t r = 0; r < Readers; r++) {
+        readers.push_back(core::Thread([&] {
+            while (!done.load(std::memory_order_relaxed)) {
+                auto pin = index.Acquire();
+                const auto* words = reinterpret_cast<const uint64_t*>(pin->data());
+                uint64_t version = words[0];
+                for (size_t i = 0; i < Words; i += 512) {
+                    if (words[i] != version) {
+                        torn++;
+                    }
+                }
+                reads++;
+            }
+        }));
+    }
+
+    for (size_t i = 1; i <= Reloads; i++) {
+        // Let readers make progress between reloads so they overlap them
+        size_t seen = reads.load();
+        while (reads.load() == seen) {
+            sched_yield();
+        }
+        index.Reload(Open(paths_[i % Versions]));
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.Join();
+    }
+
+    EXPECT_EQ(index.Generation(), Reloads);
+    EXPECT_EQ(torn.load(), 0);
+    EXPECT_GT(reads.load(), 0);
+    EXPECT_EQ(reinterpret_cast<const uint64_t*>(index.Acquire()->data())[0], Reloads % Versions);
+}
+
+TEST_F(HotSwapTest, RejectsNull) {
+    EXPECT_THROW(HotSwap<MemMapFile>{nullptr}, std::invalid_argument);
+    HotSwap<MemMapFile> index(Open(paths_[0]));
+    EXPECT_THROW(index.Reload(nullptr), std::invalid_argument);
+    EXPECT_EQ(index.Generation(), 0);
+}
@@ -1,10 +1,13 @@
 #include "core/mem_map_file.h"
+#include "core/mapping.h"
+#include "core/thread.h"
 
 #include <gtest/gtest.h>
 #include <fstream>
 #include <filesystem>
 #include <string_view>
 #include <span>
+#include <vector>
 
 namespace fs = std::filesystem;
 
@@ -52,3 +55,77 @@ TEST_F(MemoryMappedFileTest, MissingFile) {
         MemMapFile file(temp_file_path_.string());;
     }, core::FileOpenFailure);
 }
+
+TEST_F(MemoryMappedFileTest, HugePageMapping) {
+    MemMapFile file(temp_file_path_.string(), core::MemMapFileOptions{.forceInMemory = false, .hugePages = true});
+
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(file.data()) % core::HugePageSize, 0);
+    std::span<const char> file_data(file.data(), file.size());
+    EXPECT_TRUE(SpanEqual(file_data, kTestData));
+    EXPECT_LE(file.HugePageBytes(), core::HugePageSize);
+}
+
+class MemoryMappedFileWarmupTest : public ::testing::Test {
+protected:
+    static constexpr size_t FileSize = (10 * 1024 * 1024) + 123;
+
+    fs::path temp_file_path_;
+
+    void SetUp() override {
+        temp_file_path_ = fs::temp_directory_path() / "mmap_warmup_test_file";
+        std::string contents(FileSize, '\0');
+        for (size_t i = 0; i < contents.size(); i++) {
+            contents[i] = static_cast<char>(i * 31);
+        }
+        std::ofstream ofs(temp_file_path_, std::ios::binary);
+        ofs.write(contents.data(), contents.size());
+    }
+
+    void TearDown() override { fs::remove(temp_file_path_); }
+};
+
+TEST_F(MemoryMappedFileWarmupTest, ParallelPopulate) {
+    MemMapFile file(temp_file_path_.string(),
+                    core::MemMapFileOptions{.prefault = core::Prefault::Populate, .prefaultThreads = 4});
+    EXPECT_TRUE(file.WarmedUp());
+    EXPECT_EQ(file.PrefaultedBytes(), FileSize);
+    EXPECT_GT(file.ResidentFraction(), 0.99);
+    EXPECT_EQ(file.data()[FileSize - 1], static_cast<char>((FileSize - 1) * 31));
+}
+
+TEST_F(MemoryMappedFileWarmupTest, AsyncTouch) {
+    MemMapFile file(temp_file_path_.string(), core::MemMapFileOptions{.prefaultThreads = 2, .asyncPrefault = true});
+
+    // Mapping is readable while warm-up runs
+    EXPECT_EQ(file.data()[12345], static_cast<char>(12345 * 31));
+    file.WaitForWarmup();
+    EXPECT_TRUE(file.WarmedUp());
+    EXPECT_EQ(file.PrefaultedBytes(), FileSize);
+
+    // Closing during warm-up stops it first
+    MemMapFile abandoned(temp_file_path_.string(), core::MemMapFileOptions{.asyncPrefault = true});
+}
+
+TEST_F(MemoryMappedFileWarmupTest, ConcurrentWaitForWarmup) {
+    MemMapFile file(temp_file_path_.string(), core::MemMapFileOptions{.prefaultThreads = 4, .asyncPrefault = true});
+
+    std::vector<core::Thread> waiters;
+    for (int i = 0; i < 4; i++) {
+        waiters.emplace_back([&file] {
+            file.WaitForWarmup();
+            EXPECT_TRUE(file.WarmedUp());
+        });
+    }
+    file.WaitForWarmup();
+    for (auto& waiter : waiters) {
+        waiter.Join();
+    }
+    EXPECT_EQ(file.PrefaultedBytes(), FileSize);
+}
+
+TEST_F(MemoryMappedFileWarmupTest, NoWarmupWithoutForceInMemory) {
+    MemMapFile file(temp_file_path_.string(), false);
+    EXPECT_TRUE(file.WarmedUp());
+    EXPECT_FALSE(file.Locked());
+    EXPECT_EQ(file.PrefaultedBytes(), 0);
+}
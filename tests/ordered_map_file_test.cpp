@@ -1,6 +1,15 @@
 #include "core/ordered_map_file.h"
+#include "core/read_only_file.h"
+#include "core/thread.h"
 
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
 #include <gtest/gtest.h>
 
 using namespace core;
@@ -316,3 +325,640 @@ TEST_F(OrderedMapFileTest, AnotherFixedSizeRecordPersistence) {
         EXPECT_STREQ(found2->value->description, "Persistent Description Two");
     }
 }
+
+TEST_F(OrderedMapFileTest, ReadOnlyOpen) {
+    auto compare = U32Compare{};
+    {
+        auto tree = OrderedMapFile<uint32_t, uint32_t, 5, decltype(compare)>{OrderedMapFileName, compare};
+        for (uint32_t i = 0; i < 100; i++) {
+            tree.Insert(i, i * 10);
+        }
+    }
+
+    {
+        ReadOnlyFile<OrderedMapFile<uint32_t, uint32_t, 5, decltype(compare)>> tree(
+            OrderedMapFileName, compare, VectorFileOptions{.access = AccessHint::Random});
+        EXPECT_EQ(tree->Size(), 100);
+        for (uint32_t i = 0; i < 100; i++) {
+            auto found = tree->Find(i);
+            ASSERT_TRUE(found.HasValue());
+            EXPECT_EQ(*found->value, i * 10);
+        }
+        EXPECT_FALSE(tree->Contains(100));
+    }
+
+    auto tree = OrderedMapFile<uint32_t, uint32_t, 5, decltype(compare)>{
+        OrderedMapFileName, compare, VectorFileOptions{.readOnly = true}};
+    EXPECT_THROW(tree.Insert(100, 1000), std::runtime_error);
+    EXPECT_FALSE(tree.Contains(100));
+}
+
+TEST_F(OrderedMapFileTest, ReadOnlyMissingFile) {
+    auto compare = U32Compare{};
+    using Tree = OrderedMapFile<uint32_t, uint32_t, 5, decltype(compare)>;
+    EXPECT_THROW(Tree(OrderedMapFileName, compare, VectorFileOptions{.readOnly = true}), std::runtime_error);
+    EXPECT_FALSE(std::filesystem::exists(OrderedMapFileName));
+}
+
+TEST_F(OrderedMapFileTest, RejectsOtherLayouts) {
+    auto compare = U32Compare{};
+    {
+        auto tree = OrderedMapFile<uint32_t, uint32_t, 5, decltype(compare)>{OrderedMapFileName, compare};
+        tree.Insert(1, 10);
+    }
+
+    using Wider = OrderedMapFile<uint32_t, uint64_t, 5, decltype(compare)>;
+    EXPECT_THROW(Wider(OrderedMapFileName, compare), std::runtime_error);
+
+    // A vector file that is not a node file
+    std::filesystem::remove(OrderedMapFileName);
+    using Tree = OrderedMapFile<uint32_t, uint32_t, 5, decltype(compare)>;
+    {
+        VectorFile<uint32_t> other(OrderedMapFileName);
+        other.PushBack(1);
+    }
+    EXPECT_THROW(Tree(OrderedMapFileName, compare), std::runtime_error);
+}
+
+TEST_F(OrderedMapFileTest, BulkLoadThenInsert) {
+    auto compare = U32Compare{};
+    using Tree = OrderedMapFile<uint32_t, uint32_t, 5, decltype(compare)>;
+
+    for (uint32_t count : {0U, 1U, 5U, 6U, 23U, 1000U}) {
+        for (double fill : {1.0, 0.7, 0.5}) {
+            std::filesystem::remove(OrderedMapFileName);
+            auto tree = Tree{OrderedMapFileName, compare};
+
+            // Even keys only, leaving gaps for later inserts
+            std::vector<std::pair<uint32_t, uint32_t>> input;
+            for (uint32_t i = 0; i < count; i++) {
+                input.emplace_back(i * 2, i * 20);
+            }
+            EXPECT_EQ(tree.BulkLoad(input.begin(), input.end(), fill), count);
+            EXPECT_EQ(tree.Size(), count);
+
+            for (uint32_t i = 0; i < count; i++) {
+                auto found = tree.Find(i * 2);
+                ASSERT_TRUE(found.HasValue()) << "count " << count << " fill " << fill << " key " << i * 2;
+                EXPECT_EQ(*found->value, i * 20);
+                EXPECT_FALSE(tree.Contains(i * 2 + 1));
+            }
+
+            // Tree stays valid for inserts into gaps and past the end
+            for (uint32_t i = 0; i < count + 10; i++) {
+                EXPECT_TRUE(tree.Insert(i * 2 + 1, i));
+            }
+            if (count > 0) {
+                EXPECT_FALSE(tree.Insert(0, 0));
+            }
+            for (uint32_t i = 0; i < count + 10; i++) {
+                ASSERT_TRUE(tree.Contains(i * 2 + 1));
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                ASSERT_TRUE(tree.Contains(i * 2));
+            }
+
+            // Erasing everything rebalances the bulk-built tree down to empty
+            for (uint32_t i = 0; i < (count + 10) * 2; i++) {
+                EXPECT_EQ(tree.Erase(i), i % 2 == 1 || i / 2 < count);
+            }
+            EXPECT_TRUE(tree.Empty());
+        }
+    }
+}
+
+TEST_F(OrderedMapFileTest, BulkLoadRejectsUnsortedAndNonEmpty) {
+    auto compare = U32Compare{};
+    auto tree = OrderedMapFile<uint32_t, uint32_t, 5, decltype(compare)>{OrderedMapFileName, compare};
+
+    std::vector<std::pair<uint32_t, uint32_t>> input;
+    for (uint32_t i = 0; i < 100; i++) {
+        input.emplace_back(i, i);
+    }
+    input[50].first = 10;
+    EXPECT_THROW(tree.BulkLoad(input.begin(), input.end()), std::invalid_argument);
+    EXPECT_TRUE(tree.Empty());
+    EXPECT_FALSE(tree.Contains(1));
+
+    input[50].first = 50;
+    EXPECT_EQ(tree.BulkLoad(input.begin(), input.end()), 100);
+    EXPECT_THROW(tree.BulkLoad(input.begin(), input.end()), std::runtime_error);
+}
+
+TEST_F(OrderedMapFileTest, OrderedIterationAndBounds) {
+    auto compare = U32Compare{};
+    auto tree = OrderedMapFile<uint32_t, uint32_t, 5, decltype(compare)>{OrderedMapFileName, compare};
+    EXPECT_EQ(tree.begin(), tree.end());
+    EXPECT_EQ(tree.LowerBound(3), tree.end());
+
+    // Multiples of 3 inserted out of order
+    for (uint32_t i = 0; i < 500; i++) {
+        uint32_t key = ((i * 7919) % 500) * 3;
+        ASSERT_TRUE(tree.Insert(key, key + 1));
+    }
+
+    uint32_t expected = 0;
+    for (auto pair : tree) {
+        EXPECT_EQ(*pair.key, expected);
+        EXPECT_EQ(*pair.value, expected + 1);
+        expected += 3;
+    }
+    EXPECT_EQ(expected, 1500);
+
+    EXPECT_EQ(*(*tree.LowerBound(0)).key, 0);
+    EXPECT_EQ(*(*tree.LowerBound(1)).key, 3);
+    EXPECT_EQ(*(*tree.LowerBound(300)).key, 300);
+    EXPECT_EQ(*(*tree.UpperBound(300)).key, 303);
+    EXPECT_EQ(*(*tree.UpperBound(301)).key, 303);
+    EXPECT_EQ(tree.LowerBound(1498), tree.end());
+    EXPECT_EQ(tree.UpperBound(1497), tree.end());
+
+    std::vector<uint32_t> keys;
+    for (auto pair : tree.Range(100, 130)) {
+        keys.push_back(*pair.key);
+    }
+    EXPECT_EQ(keys, (std::vector<uint32_t>{102, 105, 108, 111, 114, 117, 120, 123, 126, 129}));
+
+    auto empty = tree.Range(130, 100);
+    EXPECT_EQ(empty.begin(), empty.end());
+    auto tail = tree.Range(1490, 5000);
+    EXPECT_EQ(std::distance(tail.begin(), tail.end()), 3);
+
+    // lo past every key, hi < lo
+    auto past_end = tree.Range(5000, 5);
+    EXPECT_EQ(past_end.begin(), past_end.end());
+    EXPECT_EQ(std::distance(past_end.begin(), past_end.end()), 0);
+}
+
+TEST_F(OrderedMapFileTest, BulkLoadedIteration) {
+    auto compare = U32Compare{};
+    auto tree = OrderedMapFile<uint32_t, uint32_t, 5, decltype(compare)>{OrderedMapFileName, compare};
+
+    std::vector<std::pair<uint32_t, uint32_t>> input;
+    for (uint32_t i = 0; i < 1000; i++) {
+        input.emplace_back(i * 2, i);
+    }
+    tree.BulkLoad(input.begin(), input.end(), 0.8);
+    tree.Insert(7, 0);
+
+    std::vector<uint32_t> keys;
+    for (auto pair : tree) {
+        keys.push_back(*pair.key);
+    }
+    ASSERT_EQ(keys.size(), 1001);
+    EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+    EXPECT_EQ(keys[4], 7);
+}
+
+TEST_F(OrderedMapFileTest, InsertOrAssignAndUpsert) {
+    auto compare = U32Compare{};
+    auto tree = OrderedMapFile<uint32_t, uint32_t, 5, decltype(compare)>{OrderedMapFileName, compare};
+
+    EXPECT_TRUE(tree.InsertOrAssign(1, 10));
+    EXPECT_FALSE(tree.InsertOrAssign(1, 11));
+    EXPECT_EQ(*tree.Find(1)->value, 11);
+
+    EXPECT_TRUE(tree.Upsert(2, [](uint32_t& v) { v += 5; }));
+    EXPECT_FALSE(tree.Upsert(2, [](uint32_t& v) { v += 5; }));
+    EXPECT_EQ(*tree.Find(2)->value, 10);
+    EXPECT_EQ(tree.Size(), 2);
+}
+
+TEST_F(OrderedMapFileTest, EraseMatchesReference) {
+    auto compare = U32Compare{};
+
+    for (int seed = 0; seed < 3; seed++) {
+        std::filesystem::remove(OrderedMapFileName);
+        auto tree = OrderedMapFile<uint32_t, uint32_t, 4, decltype(compare)>{OrderedMapFileName, compare};
+        std::map<uint32_t, uint32_t> reference;
+        std::mt19937 rng(seed);
+
+        for (int op = 0; op < 20000; op++) {
+            uint32_t key = rng() % 2000;
+            if (rng() % 3 == 0) {
+                EXPECT_EQ(tree.Erase(key), reference.erase(key) == 1) << "erase " << key;
+            } else {
+                EXPECT_EQ(tree.InsertOrAssign(key, op), !reference.contains(key)) << "insert " << key;
+                reference[key] = op;
+            }
+        }
+
+        ASSERT_EQ(tree.Size(), reference.size());
+        auto it = reference.begin();
+        for (auto pair : tree) {
+            ASSERT_NE(it, reference.end());
+            EXPECT_EQ(*pair.key, it->first);
+            EXPECT_EQ(*pair.value, it->second);
+            ++it;
+        }
+        EXPECT_EQ(it, reference.end());
+        for (uint32_t key = 0; key < 2000; key++) {
+            EXPECT_EQ(tree.Contains(key), reference.contains(key)) << "key " << key;
+        }
+    }
+}
+
+TEST_F(OrderedMapFileTest, EraseReclaimsNodes) {
+    auto compare = U32Compare{};
+    auto tree = OrderedMapFile<uint32_t, uint32_t, 5, decltype(compare)>{OrderedMapFileName, compare};
+
+    for (uint32_t i = 0; i < 5000; i++) {
+        tree.Insert(i, i);
+    }
+    auto full_size = std::filesystem::file_size(OrderedMapFileName);
+
+    for (uint32_t i = 0; i < 5000; i++) {
+        ASSERT_TRUE(tree.Erase(i));
+    }
+    EXPECT_TRUE(tree.Empty());
+    EXPECT_FALSE(tree.Erase(0));
+    EXPECT_EQ(tree.begin(), tree.end());
+
+    // Reinserting reuses reclaimed nodes rather than growing the file
+    for (uint32_t round = 0; round < 3; round++) {
+        for (uint32_t i = 0; i < 5000; i++) {
+            tree.Insert(i, i);
+        }
+        for (uint32_t i = 0; i < 5000; i += 2) {
+            tree.Erase(i);
+        }
+        for (uint32_t i = 1; i < 5000; i += 2) {
+            ASSERT_TRUE(tree.Find(i).HasValue());
+        }
+        for (uint32_t i = 1; i < 5000; i += 2) {
+            tree.Erase(i);
+        }
+    }
+    EXPECT_LE(std::filesystem::file_size(OrderedMapFileName), full_size);
+}
+
+template<typename Key, size_t N>
+void CheckNaturalOrderAgainstReference(const char* path, Key lo, Key hi) {
+    std::filesystem::remove(path);
+    auto tree = OrderedMapFile<Key, uint32_t, N, NaturalOrder>{path, NaturalOrder{}};
+    std::map<Key, uint32_t> reference;
+    std::mt19937_64 rng(N);
+    std::uniform_int_distribution<Key> dist(lo, hi);
+
+    for (uint32_t op = 0; op < 20000; op++) {
+        Key key = dist(rng);
+        if (rng() % 3 == 0) {
+            EXPECT_EQ(tree.Erase(key), reference.erase(key) == 1);
+        } else {
+            EXPECT_EQ(tree.InsertOrAssign(key, op), !reference.contains(key));
+            reference[key] = op;
+        }
+    }
+
+    ASSERT_EQ(tree.Size(), reference.size());
+    auto it = reference.begin();
+    for (auto pair : tree) {
+        ASSERT_NE(it, reference.end());
+        EXPECT_EQ(*pair.key, it->first);
+        EXPECT_EQ(*pair.value, it->second);
+        ++it;
+    }
+    for (int i = 0; i < 2000; i++) {
+        Key key = dist(rng);
+        auto expected = reference.lower_bound(key);
+        auto found = tree.LowerBound(key);
+        if (expected == reference.end()) {
+            EXPECT_EQ(found, tree.end());
+        } else {
+            ASSERT_NE(found, tree.end());
+            EXPECT_EQ(*(*found).key, expected->first);
+        }
+        EXPECT_EQ(tree.Contains(key), reference.contains(key));
+    }
+}
+
+TEST_F(OrderedMapFileTest, NaturalOrderIntegerKeys) {
+    // Node sizes cover whole vectors, partial vectors, and scalar remainders;
+    // key ranges cover negative keys and unsigned keys with the top bit set
+    CheckNaturalOrderAgainstReference<uint32_t, 4>(OrderedMapFileName, 0, 3000);
+    CheckNaturalOrderAgainstReference<uint32_t, 13>(OrderedMapFileName, UINT32_MAX - 3000, UINT32_MAX);
+    CheckNaturalOrderAgainstReference<int32_t, 64>(OrderedMapFileName, -1500, 1500);
+    CheckNaturalOrderAgainstReference<uint64_t, 7>(OrderedMapFileName, UINT64_MAX - 3000, UINT64_MAX);
+    CheckNaturalOrderAgainstReference<int64_t, 128>(OrderedMapFileName, -1500, 1500);
+}
+
+template<typename Key>
+void CheckCountLessPaths(Key lo, Key hi) {
+    std::mt19937_64 rng(sizeof(Key));
+    std::uniform_int_distribution<Key> dist(lo, hi);
+    std::vector<Key> keys;
+    for (uint32_t count = 0; count < 40; count++) {
+        for (int probe = 0; probe < 50; probe++) {
+            Key key = dist(rng);
+            uint32_t expected = internal::CountLessScalar(keys.data(), count, key);
+#ifdef LIB_KEY_SEARCH_X86
+            const auto& cpu = internal::DetectKeySearchCpu();
+            if (cpu.sse42) {
+                EXPECT_EQ(internal::CountLessSse42(keys.data(), count, key), expected);
+            }
+            if (cpu.avx2) {
+                EXPECT_EQ(internal::CountLessAvx2(keys.data(), count, key), expected);
+            }
+#endif
+            EXPECT_EQ(internal::CountLess(keys.data(), count, key), expected);
+        }
+        keys.push_back(dist(rng));
+    }
+}
+
+TEST_F(OrderedMapFileTest, CountLessVectorPathsMatchScalar) {
+    // Each vector path the CPU supports is checked directly, whichever one
+    // CountLess dispatches to
+    CheckCountLessPaths<uint32_t>(0, UINT32_MAX);
+    CheckCountLessPaths<int32_t>(INT32_MIN, INT32_MAX);
+    CheckCountLessPaths<uint64_t>(0, UINT64_MAX);
+    CheckCountLessPaths<int64_t>(INT64_MIN, INT64_MAX);
+}
+
+TEST_F(OrderedMapFileTest, NaturalOrderMixedSignedness) {
+    auto tree = OrderedMapFile<uint64_t, uint32_t, 4, NaturalOrder>{OrderedMapFileName, NaturalOrder{}};
+    for (uint64_t key = 0; key < 100; key++) {
+        tree.Insert(key, static_cast<uint32_t>(key));
+    }
+
+    // A negative probe orders before every unsigned key instead of wrapping
+    // around to a huge value
+    EXPECT_FALSE(tree.Contains(-1));
+    EXPECT_EQ(*(*tree.LowerBound(-1)).key, 0);
+    EXPECT_TRUE(tree.Contains(42));
+    EXPECT_EQ(*(*tree.LowerBound(int64_t{99})).key, 99);
+}
+
+TEST_F(OrderedMapFileTest, GetDuringConcurrentWrites) {
+    constexpr uint64_t Keys = 40000;
+    constexpr int Readers = 4;
+
+    auto tree = OrderedMapFile<uint64_t, uint64_t, 5, NaturalOrder>{
+        OrderedMapFileName, NaturalOrder{}, VectorFileOptions{.reserveBytes = 256 * 1024 * 1024}};
+    std::atomic<uint64_t> inserted{0};
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> errors{0};
+
+    std::vector<core::Thread> readers;
+    for (int t = 0; t < Readers; t++) {
+        readers.emplace_back([&, t] {
+            std::mt19937_64 rng(t);
+            while (!done.load()) {
+                // Keys below the watermark were inserted and even ones are
+                // never erased
+                uint64_t watermark = inserted.load();
+                uint64_t key = rng() % Keys;
+                auto value = tree.Get(key);
+                if (value.HasValue() && *value != key * 3) {
+                    ++errors;
+                }
+                if (key < watermark && key % 2 == 0 && !value.HasValue()) {
+                    ++errors;
+                }
+            }
+        });
+    }
+
+    for (uint64_t key = 0; key < Keys; key++) {
+        tree.Insert(key, key * 3);
+        inserted.store(key + 1);
+    }
+    for (uint64_t key = 1; key < Keys; key += 2) {
+        tree.Erase(key);
+    }
+    done.store(true);
+    for (auto& reader : readers) {
+        reader.Join();
+    }
+
+    EXPECT_EQ(errors.load(), 0);
+    EXPECT_EQ(tree.Size(), Keys / 2);
+    for (uint64_t key = 0; key < Keys; key++) {
+        EXPECT_EQ(tree.Get(key).HasValue(), key % 2 == 0);
+    }
+}
+
+TEST_F(OrderedMapFileTest, GetRequiresStableAddress) {
+    auto tree = OrderedMapFile<uint64_t, uint64_t, 5, NaturalOrder>{OrderedMapFileName, NaturalOrder{}};
+    tree.Insert(1, 2);
+    EXPECT_THROW(tree.Get(1), std::runtime_error);
+}
+
+TEST_F(OrderedMapFileTest, StableAddressMapNeverShrinks) {
+    constexpr uint64_t Keys = 20000;
+    using Tree = OrderedMapFile<uint64_t, uint64_t, 5, NaturalOrder>;
+    Tree tree{OrderedMapFileName, NaturalOrder{}, VectorFileOptions{.reserveBytes = 256 * 1024 * 1024}};
+    for (uint64_t key = 0; key < Keys; key++) {
+        tree.Insert(key, key);
+    }
+    auto nodes = tree.Stats().nodeCount;
+    auto file_size = std::filesystem::file_size(OrderedMapFileName);
+
+    // Freed nodes, the last one included, stay mapped for concurrent readers
+    for (uint64_t key = 0; key < Keys; key++) {
+        tree.Erase(key);
+    }
+    EXPECT_TRUE(tree.Empty());
+    EXPECT_EQ(std::filesystem::file_size(OrderedMapFileName), file_size);
+
+    // A bulk load reuses the freed nodes instead of growing the file
+    std::vector<std::pair<uint64_t, uint64_t>> pairs;
+    for (uint64_t key = 0; key < Keys; key++) {
+        pairs.emplace_back(key, key * 2);
+    }
+    tree.BulkLoad(pairs.begin(), pairs.end());
+    EXPECT_LE(tree.Stats().nodeCount, nodes);
+    EXPECT_EQ(std::filesystem::file_size(OrderedMapFileName), file_size);
+    for (uint64_t key = 0; key < Keys; key += 97) {
+        EXPECT_EQ(*tree.Get(key), key * 2);
+    }
+}
+
+TEST_F(OrderedMapFileTest, FindManyMatchesFind) {
+    auto compare = U32Compare{};
+    auto tree = OrderedMapFile<uint32_t, uint32_t, 5, decltype(compare)>{OrderedMapFileName, compare};
+    using ConstPair = decltype(tree)::ConstPair;
+
+    // Empty map finds nothing
+    std::vector<uint32_t> keys{1, 2, 3};
+    std::vector<core::Optional<ConstPair>> out(keys.size());
+    tree.FindMany(core::Span<const uint32_t>{keys.data(), keys.size()}, core::Span{out.data(), out.size()});
+    for (const auto& found : out) {
+        EXPECT_FALSE(found.HasValue());
+    }
+
+    for (uint32_t i = 0; i < 5000; i++) {
+        tree.Insert(i * 2, i);
+    }
+
+    // Batch sizes around the group size, with present and absent keys
+    std::mt19937 rng(3);
+    for (size_t count : {0, 1, 15, 16, 17, 1000}) {
+        keys.clear();
+        for (size_t i = 0; i < count; i++) {
+            keys.push_back(rng() % 10020);
+        }
+        out.assign(count, core::nullopt);
+        tree.FindMany(core::Span<const uint32_t>{keys.data(), keys.size()}, core::Span{out.data(), out.size()});
+        for (size_t i = 0; i < count; i++) {
+            auto expected = tree.Find(keys[i]);
+            ASSERT_EQ(out[i].HasValue(), expected.HasValue()) << "key " << keys[i];
+            if (expected.HasValue()) {
+                EXPECT_EQ(out[i]->value, expected->value);
+                EXPECT_EQ(*out[i]->key, keys[i]);
+            }
+        }
+    }
+
+    out.resize(1);
+    keys.assign(2, 0);
+    EXPECT_THROW(
+        tree.FindMany(core::Span<const uint32_t>{keys.data(), keys.size()}, core::Span{out.data(), out.size()}),
+        std::invalid_argument);
+}
+
+TEST_F(OrderedMapFileTest, StatsDescribeTree) {
+    auto tree = OrderedMapFile<uint32_t, uint32_t, 8, NaturalOrder>{OrderedMapFileName, NaturalOrder{}};
+
+    auto empty = tree.Stats();
+    EXPECT_EQ(empty.depth, 1);
+    EXPECT_EQ(empty.nodeCount, 1);
+    EXPECT_TRUE(empty.keyDeciles.empty());
+
+    for (uint32_t i = 0; i < 1001; i++) {
+        tree.Insert(i, i);
+    }
+    for (uint32_t i = 0; i < 1001; i += 3) {
+        tree.Erase(i);
+    }
+
+    auto stats = tree.Stats();
+    EXPECT_EQ(stats.size, tree.Size());
+    EXPECT_EQ(stats.depth, stats.levels.size());
+    EXPECT_GE(stats.depth, 3);
+    EXPECT_EQ(stats.levels[0].nodes, 1);
+
+    size_t reachable = 0;
+    for (const auto& level : stats.levels) {
+        reachable += level.nodes;
+        EXPECT_GT(level.fillFactor, 0);
+        EXPECT_LE(level.fillFactor, 1);
+        // Just-written nodes are in the page cache
+        EXPECT_EQ(level.residentNodes, level.nodes);
+    }
+    EXPECT_EQ(reachable + stats.freeNodes, stats.nodeCount);
+    EXPECT_EQ(stats.levels[stats.depth - 1].keys, tree.Size());
+    EXPECT_EQ(stats.leafBytes, stats.levels[stats.depth - 1].nodes * stats.nodeBytes);
+    EXPECT_EQ(stats.internalBytes + stats.leafBytes, reachable * stats.nodeBytes);
+
+    size_t leaves = 0;
+    for (size_t count : stats.leafFillHistogram) {
+        leaves += count;
+    }
+    EXPECT_EQ(leaves, stats.levels[stats.depth - 1].nodes);
+
+    ASSERT_EQ(stats.keyDeciles.size(), 11);
+    EXPECT_EQ(stats.keyDeciles[0], 1);
+    EXPECT_EQ(stats.keyDeciles[10], 1000);
+    EXPECT_TRUE(std::is_sorted(stats.keyDeciles.begin(), stats.keyDeciles.end()));
+}
+
+TEST_F(OrderedMapFileTest, CompactRelaysOutTree) {
+    std::map<uint32_t, uint32_t> reference;
+    std::mt19937 rng(5);
+    {
+        auto tree = OrderedMapFile<uint32_t, uint32_t, 8, NaturalOrder>{OrderedMapFileName, NaturalOrder{}};
+        for (uint32_t i = 0; i < 20000; i++) {
+            uint32_t key = rng() % 50000;
+            tree.InsertOrAssign(key, i);
+            reference[key] = i;
+        }
+        for (uint32_t i = 0; i < 5000; i++) {
+            uint32_t key = rng() % 50000;
+            tree.Erase(key);
+            reference.erase(key);
+        }
+        size_t nodes_before = tree.Stats().nodeCount;
+
+        tree.Compact();
+        auto stats = tree.Stats();
+        EXPECT_EQ(stats.size, reference.size());
+        EXPECT_EQ(stats.freeNodes, 0);
+        EXPECT_LT(stats.nodeCount, nodes_before);
+        EXPECT_GT(stats.leafFillFactor, 0.95);
+
+        // Levels are contiguous, root first, and leaves are in key order
+        size_t reachable = 0;
+        for (const auto& level : stats.levels) {
+            reachable += level.nodes;
+        }
+        EXPECT_EQ(reachable, stats.nodeCount);
+        auto matches = [](auto pair, auto expected) {
+            return *pair.key == expected.first && *pair.value == expected.second;
+        };
+        EXPECT_TRUE(std::equal(tree.begin(), tree.end(), reference.begin(), reference.end(), matches));
+
+        EXPECT_GT(tree.LockUpperLevels(2), 0);
+
+        // Compacted tree takes further writes
+        for (uint32_t i = 0; i < 2000; i++) {
+            uint32_t key = rng() % 50000;
+            tree.InsertOrAssign(key, i);
+            reference[key] = i;
+        }
+    }
+
+    auto tree = OrderedMapFile<uint32_t, uint32_t, 8, NaturalOrder>{OrderedMapFileName, NaturalOrder{}};
+    EXPECT_EQ(tree.Size(), reference.size());
+    for (const auto& [key, value] : reference) {
+        auto found = tree.Find(key);
+        ASSERT_TRUE(found.HasValue()) << key;
+        EXPECT_EQ(*found->value, value);
+    }
+}
+
+TEST_F(OrderedMapFileTest, CompactFailureLeavesMapIntact) {
+    auto tree = OrderedMapFile<uint32_t, uint32_t, 8, NaturalOrder>{OrderedMapFileName, NaturalOrder{}};
+    for (uint32_t i = 0; i < 1000; i++) {
+        tree.Insert(i, i * 2);
+    }
+
+    // The new file cannot be created where a directory is in the way
+    std::string compact_path = std::string(OrderedMapFileName) + ".compact";
+    std::filesystem::create_directory(compact_path);
+    EXPECT_THROW(tree.Compact(), std::runtime_error);
+    std::filesystem::remove(compact_path);
+
+    ASSERT_EQ(tree.Size(), 1000);
+    for (uint32_t i = 0; i < 1000; i++) {
+        ASSERT_EQ(*tree.Find(i)->value, i * 2);
+    }
+    tree.Insert(1000, 2000);
+    tree.Compact();
+    EXPECT_FALSE(std::filesystem::exists(compact_path));
+    EXPECT_EQ(*tree.Find(1000)->value, 2000);
+}
+
+TEST_F(OrderedMapFileTest, CompactSmallTrees) {
+    auto tree = OrderedMapFile<uint32_t, uint32_t, 8, NaturalOrder>{OrderedMapFileName, NaturalOrder{}};
+    tree.Compact();
+    EXPECT_TRUE(tree.Empty());
+    EXPECT_EQ(tree.Stats().nodeCount, 1);
+
+    for (uint32_t count : {1, 8, 9, 64, 65, 500}) {
+        for (uint32_t i = 0; i < count; i++) {
+            tree.InsertOrAssign(i, i + 1);
+        }
+        tree.Compact(0.5);
+        ASSERT_EQ(tree.Size(), count);
+        for (uint32_t i = 0; i < count; i++) {
+            auto found = tree.Find(i);
+            ASSERT_TRUE(found.HasValue()) << count << " " << i;
+            EXPECT_EQ(*found->value, i + 1);
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            tree.Erase(i);
+        }
+        EXPECT_TRUE(tree.Empty());
+    }
+}
@@ -0,0 +1,283 @@
+#include "core/ordered_string_map_file.h"
+#include "core/read_only_file.h"
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <string>
+#include <gtest/gtest.h>
+
+using namespace core;
+
+namespace {
+
+constexpr const char* OrderedStringMapFileName = "ordered_string_map.dat";
+
+class OrderedStringMapFileTest : public ::testing::Test {
+protected:
+    void SetUp() override { std::filesystem::remove(OrderedStringMapFileName); }
+
+    void TearDown() override { std::filesystem::remove(OrderedStringMapFileName); }
+};
+
+std::string RandomUrl(std::mt19937& rng) {
+    static const char* Hosts[] = {"https://example.com/", "https://en.wikipedia.org/wiki/", "http://a.io/", ""};
+    std::string url = Hosts[rng() % 4];
+    size_t length = rng() % 40;
+    for (size_t i = 0; i < length; i++) {
+        url += static_cast<char>('a' + (rng() % 26));
+    }
+    return url;
+}
+
+}  // namespace
+
+TEST_F(OrderedStringMapFileTest, InsertAndFind) {
+    OrderedStringMapFile<uint32_t> map(OrderedStringMapFileName);
+    EXPECT_FALSE(map.Contains("missing"));
+
+    EXPECT_TRUE(map.Insert("banana", 2));
+    EXPECT_TRUE(map.Insert("apple", 1));
+    EXPECT_TRUE(map.Insert("", 0));
+    EXPECT_FALSE(map.Insert("apple", 5));
+    EXPECT_EQ(map.Size(), 3);
+
+    ASSERT_NE(map.Find("apple"), nullptr);
+    EXPECT_EQ(*map.Find("apple"), 1);
+    EXPECT_EQ(*map.Find(String{"banana"}), 2);
+    EXPECT_EQ(*map.Find(StringView{"bananas", 6}), 2);
+    EXPECT_EQ(*map.Find(""), 0);
+    EXPECT_FALSE(map.Contains("app"));
+    EXPECT_FALSE(map.Contains("bananas"));
+
+    EXPECT_FALSE(map.InsertOrAssign("apple", 10));
+    EXPECT_EQ(*map.Find("apple"), 10);
+}
+
+TEST_F(OrderedStringMapFileTest, MatchesReferenceAcrossSplits) {
+    std::mt19937 rng(7);
+    std::map<std::string, uint64_t> reference;
+    {
+        OrderedStringMapFile<uint64_t, 512> map(OrderedStringMapFileName);
+        for (uint64_t i = 0; i < 20000; i++) {
+            std::string url = RandomUrl(rng);
+            bool inserted = !reference.contains(url);
+            EXPECT_EQ(map.Insert(StringView{url.data(), url.size()}, i), inserted) << url;
+            if (inserted) {
+                reference[url] = i;
+            }
+        }
+        EXPECT_EQ(map.Size(), reference.size());
+    }
+
+    // Reopened map has all keys, in order
+    OrderedStringMapFile<uint64_t, 512> map(OrderedStringMapFileName);
+    for (const auto& [url, value] : reference) {
+        const uint64_t* found = map.Find(StringView{url.data(), url.size()});
+        ASSERT_NE(found, nullptr) << url;
+        EXPECT_EQ(*found, value);
+    }
+    auto it = reference.begin();
+    map.ForEach([&](StringView key, const uint64_t& value) {
+        ASSERT_NE(it, reference.end());
+        EXPECT_EQ(std::string(key.Data(), key.Size()), it->first);
+        EXPECT_EQ(value, it->second);
+        ++it;
+    });
+    EXPECT_EQ(it, reference.end());
+    for (int i = 0; i < 2000; i++) {
+        std::string url = RandomUrl(rng) + "~";
+        EXPECT_EQ(map.Contains(StringView{url.data(), url.size()}), reference.contains(url));
+    }
+}
+
+TEST_F(OrderedStringMapFileTest, LongKeysAndPrefixCompression) {
+    OrderedStringMapFile<uint32_t> map(OrderedStringMapFileName);
+
+    // Keys far longer than a fixed-width slot, sharing a long prefix
+    std::string prefix(200, 'p');
+    for (uint32_t i = 0; i < 5000; i++) {
+        std::string key = prefix + std::to_string(i);
+        ASSERT_TRUE(map.Insert(StringView{key.data(), key.size()}, i));
+    }
+    for (uint32_t i = 0; i < 5000; i++) {
+        std::string key = prefix + std::to_string(i);
+        const uint32_t* found = map.Find(StringView{key.data(), key.size()});
+        ASSERT_NE(found, nullptr);
+        EXPECT_EQ(*found, i);
+    }
+
+    // Shared prefix is stored once per node rather than once per key
+    EXPECT_LT(std::filesystem::file_size(OrderedStringMapFileName), 5000 * prefix.size() / 4);
+
+    std::string longest(decltype(map)::MaxKeySize, 'x');
+    EXPECT_TRUE(map.Insert(StringView{longest.data(), longest.size()}, 1));
+    std::string too_long = longest + "x";
+    EXPECT_THROW(map.Insert(StringView{too_long.data(), too_long.size()}, 1), std::length_error);
+}
+
+TEST_F(OrderedStringMapFileTest, DescendingLongKeys) {
+    // Every key is smaller than all before it, so the leftmost child of each
+    // internal node takes every insertion and split
+    OrderedStringMapFile<uint32_t> map(OrderedStringMapFileName);
+    std::string suffix(200, 'x');
+    char number[16];
+    for (uint32_t i = 5000; i-- > 0;) {
+        std::snprintf(number, sizeof(number), "%08u", i);
+        std::string key = number + suffix;
+        ASSERT_TRUE(map.Insert(StringView{key.data(), key.size()}, i));
+    }
+    EXPECT_EQ(map.Size(), 5000);
+
+    uint32_t expected = 0;
+    for (auto pair : map) {
+        std::snprintf(number, sizeof(number), "%08u", expected);
+        EXPECT_EQ(std::string(pair.key.Data(), pair.key.Size()), number + suffix);
+        EXPECT_EQ(*pair.value, expected);
+        ++expected;
+    }
+    EXPECT_EQ(expected, 5000);
+    for (uint32_t i = 0; i < 5000; i++) {
+        std::snprintf(number, sizeof(number), "%08u", i);
+        std::string key = number + suffix;
+        const uint32_t* found = map.Find(StringView{key.data(), key.size()});
+        ASSERT_NE(found, nullptr) << key;
+        EXPECT_EQ(*found, i);
+    }
+}
+
+TEST_F(OrderedStringMapFileTest, RandomBinaryKeys) {
+    // Reference ordered as the map orders keys, by StringView::Compare
+    auto compare = [](const std::string& a, const std::string& b) {
+        return StringView{a.data(), a.size()}.Compare(StringView{b.data(), b.size()}) < 0;
+    };
+    std::mt19937 rng(11);
+    std::map<std::string, uint32_t, decltype(compare)> reference(compare);
+    OrderedStringMapFile<uint32_t> map(OrderedStringMapFileName);
+    for (uint32_t i = 0; i < 4000; i++) {
+        // Short keys over a tiny alphabet share prefixes; long ones rarely do
+        std::string key(rng() % 2 == 0 ? rng() % 8 : rng() % 800, '\0');
+        for (char& c : key) {
+            c = static_cast<char>(rng() % 4 == 0 ? rng() % 256 : rng() % 3);
+        }
+        bool inserted = !reference.contains(key);
+        ASSERT_EQ(map.Insert(StringView{key.data(), key.size()}, i), inserted);
+        if (inserted) {
+            reference[key] = i;
+        }
+    }
+
+    ASSERT_EQ(map.Size(), reference.size());
+    auto it = reference.begin();
+    for (auto pair : map) {
+        ASSERT_NE(it, reference.end());
+        EXPECT_EQ(std::string(pair.key.Data(), pair.key.Size()), it->first);
+        EXPECT_EQ(*pair.value, it->second);
+        ++it;
+    }
+    EXPECT_EQ(it, reference.end());
+    for (const auto& [key, value] : reference) {
+        const uint32_t* found = map.Find(StringView{key.data(), key.size()});
+        ASSERT_NE(found, nullptr);
+        EXPECT_EQ(*found, value);
+    }
+}
+
+TEST_F(OrderedStringMapFileTest, LowerBoundAndRange) {
+    std::mt19937 rng(3);
+    std::map<std::string, uint64_t> reference;
+    OrderedStringMapFile<uint64_t, 512> map(OrderedStringMapFileName);
+    EXPECT_EQ(map.begin(), map.end());
+    EXPECT_EQ(map.LowerBound("a"), map.end());
+    for (uint64_t i = 0; i < 5000; i++) {
+        std::string url = RandomUrl(rng);
+        if (map.Insert(StringView{url.data(), url.size()}, i)) {
+            reference[url] = i;
+        }
+    }
+
+    for (int i = 0; i < 1000; i++) {
+        std::string key = RandomUrl(rng);
+        StringView view{key.data(), key.size()};
+        auto expected = reference.lower_bound(key);
+        auto found = map.LowerBound(view);
+        if (expected == reference.end()) {
+            EXPECT_EQ(found, map.end());
+        } else {
+            ASSERT_NE(found, map.end());
+            EXPECT_EQ(std::string((*found).key.Data(), (*found).key.Size()), expected->first);
+        }
+
+        auto upper = reference.upper_bound(key);
+        auto found_upper = map.UpperBound(view);
+        if (upper == reference.end()) {
+            EXPECT_EQ(found_upper, map.end());
+        } else {
+            ASSERT_NE(found_upper, map.end());
+            EXPECT_EQ(*(*found_upper).value, upper->second);
+        }
+    }
+
+    // All keys under one host
+    std::string lo = "https://example.com/";
+    std::string hi = "https://example.com0";
+    auto expected = reference.lower_bound(lo);
+    size_t count = 0;
+    for (auto pair : map.Range(StringView{lo.data(), lo.size()}, StringView{hi.data(), hi.size()})) {
+        ASSERT_NE(expected, reference.end());
+        EXPECT_EQ(std::string(pair.key.Data(), pair.key.Size()), expected->first);
+        ++expected;
+        ++count;
+    }
+    EXPECT_EQ(expected, reference.lower_bound(hi));
+    EXPECT_GT(count, 0);
+
+    auto empty = map.Range(StringView{hi.data(), hi.size()}, StringView{lo.data(), lo.size()});
+    EXPECT_EQ(empty.begin(), empty.end());
+}
+
+TEST_F(OrderedStringMapFileTest, ReadOnlyOpen) {
+    {
+        OrderedStringMapFile<uint32_t> map(OrderedStringMapFileName);
+        map.Insert("key", 1);
+    }
+
+    {
+        ReadOnlyFile<OrderedStringMapFile<uint32_t>> map(OrderedStringMapFileName);
+        ASSERT_NE(map->Find("key"), nullptr);
+        EXPECT_EQ(*map->Find("key"), 1);
+    }
+
+    OrderedStringMapFile<uint32_t> map(OrderedStringMapFileName, VectorFileOptions{.readOnly = true});
+    EXPECT_THROW(map.Insert("other", 2), std::runtime_error);
+}
+
+TEST_F(OrderedStringMapFileTest, EmptyMapIteration) {
+    {
+        OrderedStringMapFile<uint32_t> map(OrderedStringMapFileName);
+        EXPECT_EQ(map.begin(), map.end());
+        EXPECT_EQ(map.LowerBound("a"), map.end());
+    }
+
+    // A node file holding no nodes at all, as left by a crash before the
+    // root was written
+    std::filesystem::remove(OrderedStringMapFileName);
+    CustomVectorFile<std::array<char, 4096>, uint32_t>(OrderedStringMapFileName, VectorFileOptions{.layoutVersion = 1});
+
+    ReadOnlyFile<OrderedStringMapFile<uint32_t>> map(OrderedStringMapFileName);
+    EXPECT_EQ(map->begin(), map->end());
+    EXPECT_EQ(map->LowerBound("a"), map->end());
+    EXPECT_EQ(map->Range("a", "z").begin(), map->end());
+    size_t visited = 0;
+    map->ForEach([&](StringView, const uint32_t&) { visited++; });
+    EXPECT_EQ(visited, 0);
+}
+
+TEST_F(OrderedStringMapFileTest, RejectsOtherLayouts) {
+    // Same node and metadata sizes, but no layout version recorded
+    CustomVectorFile<std::array<char, 4096>, uint32_t>(OrderedStringMapFileName).PushBack({});
+    EXPECT_THROW(OrderedStringMapFile<uint32_t>{OrderedStringMapFileName}, std::runtime_error);
+}
@@ -0,0 +1,176 @@
+#include "core/parallel_scan.h"
+#include "core/vector_file.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <vector>
+
+using namespace core;
+
+namespace {
+
+constexpr const char* ScanFileName = "parallel_scan.dat";
+
+class ParallelScanTest : public ::testing::Test {
+protected:
+    void SetUp() override { std::filesystem::remove(ScanFileName); }
+    void TearDown() override { std::filesystem::remove(ScanFileName); }
+};
+
+// Size does not divide the page size, so elements straddle chunk boundaries
+struct Record {
+    uint32_t id;
+    uint32_t score;
+    uint32_t flags;
+};
+
+}  // namespace
+
+TEST_F(ParallelScanTest, ForEachVisitsEveryElementOnce) {
+    VectorFile<Record> file(ScanFileName);
+    constexpr size_t Count = 100000;
+    for (uint32_t i = 0; i < Count; ++i) {
+        file.PushBack(Record{.id = i, .score = i % 97, .flags = 0});
+    }
+
+    std::vector<std::atomic<int>> visits(Count);
+    ParallelForEach(
+        file,
+        [&](const Record& record, size_t index) {
+            EXPECT_EQ(record.id, index);
+            visits[index].fetch_add(1, std::memory_order_relaxed);
+        },
+        ScanOptions{.chunkBytes = 3 * PageSize, .prefetchChunks = 2, .threads = 4});
+
+    for (size_t i = 0; i < Count; ++i) {
+        ASSERT_EQ(visits[i].load(), 1) << "index " << i;
+    }
+}
+
+TEST_F(ParallelScanTest, ReduceMatchesSequential) {
+    VectorFile<Record> file(ScanFileName);
+    uint64_t expected = 0;
+    for (uint32_t i = 0; i < 50000; ++i) {
+        file.PushBack(Record{.id = i, .score = (i * 31) % 1000, .flags = 0});
+        expected += (i * 31) % 1000;
+    }
+
+    auto sum = [&](ScanOptions options) {
+        return ParallelReduce(
+            file,
+            uint64_t{0},
+            [](uint64_t acc, const Record& record) { return acc + record.score; },
+            [](uint64_t a, uint64_t b) { return a + b; },
+            options);
+    };
+
+    EXPECT_EQ(sum({.chunkBytes = PageSize}), expected);
+    // Releasing consumed pages drops them from the page cache, not the file
+    EXPECT_EQ(sum({.chunkBytes = PageSize, .releaseConsumed = true}), expected);
+    EXPECT_EQ(sum({}), expected);
+}
+
+TEST_F(ParallelScanTest, ReduceCombinesInChunkOrder) {
+    std::vector<uint32_t> values(20000);
+    for (size_t i = 0; i < values.size(); ++i) {
+        values[i] = static_cast<uint32_t>(i);
+    }
+
+    // Builds the sequence of first elements per chunk; only associative
+    auto firsts = ParallelReduce(
+        core::Span<const uint32_t>{values.data(), values.size()},
+        std::vector<uint32_t>{},
+        [](std::vector<uint32_t> acc, uint32_t value) {
+            if (acc.empty()) {
+                acc.push_back(value);
+            }
+            return acc;
+        },
+        [](std::vector<uint32_t> a, std::vector<uint32_t> b) {
+            a.insert(a.end(), b.begin(), b.end());
+            return a;
+        },
+        ScanOptions{.chunkBytes = PageSize, .threads = 4});
+
+    ASSERT_FALSE(firsts.empty());
+    EXPECT_EQ(firsts.front(), 0);
+    for (size_t i = 1; i < firsts.size(); ++i) {
+        EXPECT_LT(firsts[i - 1], firsts[i]);
+    }
+}
+
+TEST_F(ParallelScanTest, MemMapFileArrayView) {
+    {
+        std::ofstream out(ScanFileName, std::ios::binary);
+        for (uint64_t i = 0; i < 10000; ++i) {
+            out.write(reinterpret_cast<const char*>(&i), sizeof(i));
+        }
+        out.write("xyz", 3);  // Trailing partial element is ignored
+    }
+
+    MemMapFile file(ScanFileName, false);
+    auto view = ArrayView<uint64_t>(file);
+    ASSERT_EQ(view.Size(), 10000);
+
+    uint64_t sum = ParallelReduce(
+        view, uint64_t{0}, [](uint64_t acc, uint64_t v) { return acc + v; }, [](uint64_t a, uint64_t b) { return a + b; });
+    EXPECT_EQ(sum, 10000ULL * 9999 / 2);
+}
+
+TEST_F(ParallelScanTest, MemMapFileReleaseConsumed) {
+    {
+        std::ofstream out(ScanFileName, std::ios::binary);
+        for (uint64_t i = 0; i < 100000; ++i) {
+            out.write(reinterpret_cast<const char*>(&i), sizeof(i));
+        }
+    }
+
+    MemMapFile file(ScanFileName, false);
+    ScanOptions options{.chunkBytes = PageSize, .releaseConsumed = true};
+    std::atomic<uint64_t> visited{0};
+    ParallelForEach<uint64_t>(file, [&](uint64_t value, size_t index) { visited += value == index; }, options);
+    EXPECT_EQ(visited.load(), 100000);
+
+    // Released pages are read back from the file
+    uint64_t sum = ParallelReduce<uint64_t>(
+        file, uint64_t{0}, [](uint64_t acc, uint64_t v) { return acc + v; }, std::plus<>{}, options);
+    EXPECT_EQ(sum, 100000ULL * 99999 / 2);
+}
+
+TEST_F(ParallelScanTest, ExceptionPropagates) {
+    std::vector<int> values(100000, 1);
+    EXPECT_THROW(ParallelForEach(
+                     core::Span<const int>{values.data(), values.size()},
+                     [](int, size_t index) {
+                         if (index == 54321) {
+                             throw std::runtime_error("bad record");
+                         }
+                     },
+                     ScanOptions{.chunkBytes = PageSize}),
+                 std::runtime_error);
+}
+
+TEST_F(ParallelScanTest, EmptyInput) {
+    std::vector<int> values;
+    int calls = 0;
+    ParallelForEach(core::Span<const int>{values.data(), 0}, [&](int, size_t) { ++calls; });
+    EXPECT_EQ(calls, 0);
+    EXPECT_EQ(ParallelReduce(
+                  core::Span<const int>{values.data(), 0}, 5, [](int a, int b) { return a + b; }, [](int a, int b) { return a + b; }),
+              5);
+}
+
+TEST_F(ParallelScanTest, ReleaseNeedsFile) {
+    std::vector<uint32_t> values(10000, 1);
+    core::Span<const uint32_t> data{values.data(), values.size()};
+    ScanOptions options{.releaseConsumed = true};
+    EXPECT_THROW(ParallelForEach(data, [](uint32_t, size_t) {}, options), std::invalid_argument);
+    EXPECT_THROW(ParallelReduce(
+                     data, uint64_t{0}, [](uint64_t acc, uint32_t v) { return acc + v; }, std::plus<>{}, options),
+                 std::invalid_argument);
+}
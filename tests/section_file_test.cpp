@@ -0,0 +1,109 @@
+#include "core/section_file.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+
+using namespace core;
+
+namespace {
+
+enum : uint32_t { Postings = 1, Title = 2, Offsets = 3, Empty = 4 };
+
+struct Posting {
+    uint32_t doc;
+    uint16_t count;
+    uint16_t flags;
+};
+
+constexpr uint32_t DataVersion = 7;
+
+class SectionFileTest : public ::testing::Test {
+protected:
+    fs::path path_;
+
+    void SetUp() override {
+        path_ = fs::temp_directory_path() / "section_file_test";
+        std::vector<Posting> postings;
+        for (uint32_t i = 0; i < 1000; i++) {
+            postings.push_back(Posting{.doc = i * 3, .count = static_cast<uint16_t>(i % 7), .flags = 0});
+        }
+        std::vector<uint64_t> offsets{0, 10, 20};
+
+        SectionFileWriter writer(path_.string(), DataVersion);
+        writer.AddArray(Postings, core::Span<const Posting>{postings.data(), postings.size()});
+        writer.AddString(Title, "an index segment");
+        writer.AddArray(Offsets, core::Span<const uint64_t>{offsets.data(), offsets.size()});
+        writer.AddArray(Empty, core::Span<const uint64_t>{});
+        EXPECT_THROW(writer.AddString(Title, "again"), std::invalid_argument);
+        writer.Close();
+        EXPECT_THROW(writer.AddString(99, "closed"), std::runtime_error);
+    }
+
+    void TearDown() override { fs::remove(path_); }
+
+    void Corrupt(size_t offset) {
+        std::fstream file(path_, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg(static_cast<std::streamoff>(offset));
+        char byte = 0;
+        file.read(&byte, 1);
+        byte ^= 0x20;
+        file.seekp(static_cast<std::streamoff>(offset));
+        file.write(&byte, 1);
+    }
+};
+
+}  // namespace
+
+TEST_F(SectionFileTest, TypedViews) {
+    SectionFile file(path_.string(), DataVersion);
+    EXPECT_EQ(file.Version(), DataVersion);
+    EXPECT_EQ(file.SectionCount(), 4);
+
+    auto postings = file.Array<Posting>(Postings);
+    ASSERT_EQ(postings.Size(), 1000);
+    EXPECT_EQ(postings[999].doc, 999 * 3);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(postings.Data()) % alignof(Posting), 0);
+    EXPECT_TRUE(file.String(Title) == StringView{"an index segment"});
+    EXPECT_EQ(file.Array<uint64_t>(Offsets)[2], 20);
+    EXPECT_EQ(file.Array<uint64_t>(Empty).Size(), 0);
+
+    EXPECT_FALSE(file.Contains(99));
+    EXPECT_THROW(file.Bytes(99), std::out_of_range);
+    EXPECT_THROW(file.Array<uint32_t>(Offsets), std::invalid_argument);
+
+    // Same size, different kind
+    EXPECT_THROW(file.Array<int64_t>(Offsets), std::invalid_argument);
+    EXPECT_THROW(file.Array<double>(Offsets), std::invalid_argument);
+    EXPECT_THROW(file.Array<uint8_t>(Title), std::invalid_argument);
+    EXPECT_EQ(file.Array<char>(Title).Size(), 16);
+}
+
+TEST_F(SectionFileTest, RejectsInvalidFiles) {
+    EXPECT_THROW(SectionFile(path_.string(), DataVersion + 1), FileOpenFailure);
+
+    // Corrupt a byte of the postings section, which starts after the header
+    Corrupt(100);
+    EXPECT_THROW(SectionFile(path_.string(), DataVersion), FileOpenFailure);
+    SectionFile unverified(path_.string(), DataVersion, SectionFileOptions{.verifyChecksums = false});
+    EXPECT_EQ(unverified.Array<Posting>(Postings).Size(), 1000);
+
+    Corrupt(0);
+    EXPECT_THROW(SectionFile(path_.string(), DataVersion, SectionFileOptions{.verifyChecksums = false}),
+                 FileOpenFailure);
+}
+
+TEST_F(SectionFileTest, AbandonedWriterLeavesInvalidFile) {
+    {
+        SectionFileWriter writer(path_.string(), DataVersion);
+        writer.AddString(Title, "never closed");
+    }
+    EXPECT_THROW(SectionFile(path_.string(), DataVersion), FileOpenFailure);
+
+    { SectionFileWriter writer(path_.string(), DataVersion); }
+    EXPECT_THROW(SectionFile(path_.string(), DataVersion), FileOpenFailure);
+}
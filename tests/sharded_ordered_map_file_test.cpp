@@ -0,0 +1,171 @@
+#include "core/sharded_ordered_map_file.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace core;
+
+namespace {
+
+constexpr const char* ShardedMapFileName = "sharded_ordered_map.dat";
+constexpr size_t Shards = 4;
+
+class ShardedOrderedMapFileTest : public ::testing::Test {
+protected:
+    void SetUp() override { RemoveShards(); }
+
+    void TearDown() override { RemoveShards(); }
+
+    static void RemoveShards() {
+        for (size_t i = 0; i < Shards; i++) {
+            std::filesystem::remove(std::string{ShardedMapFileName} + "." + std::to_string(i));
+        }
+        std::filesystem::remove(std::string{ShardedMapFileName} + ".manifest");
+    }
+};
+
+std::vector<std::pair<uint64_t, uint64_t>> RandomPairs(size_t count, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<std::pair<uint64_t, uint64_t>> pairs;
+    for (size_t i = 0; i < count; i++) {
+        pairs.emplace_back(rng() % 200000, i);
+    }
+    return pairs;
+}
+
+}  // namespace
+
+TEST_F(ShardedOrderedMapFileTest, HashPartitionedParallelInsert) {
+    std::map<uint64_t, uint64_t> reference;
+    auto first = RandomPairs(50000, 1);
+    auto second = RandomPairs(50000, 2);
+    for (const auto& batch : {first, second}) {
+        for (const auto& [key, value] : batch) {
+            reference.emplace(key, value);
+        }
+    }
+
+    {
+        ShardedOrderedMapFile<uint64_t, uint64_t, 16, NaturalOrder> map(ShardedMapFileName, Shards, NaturalOrder{});
+        size_t inserted = map.InsertParallel(first.begin(), first.end());
+        inserted += map.InsertParallel(second.begin(), second.end());
+        EXPECT_EQ(inserted, reference.size());
+        EXPECT_EQ(map.Size(), reference.size());
+        for (size_t i = 0; i < Shards; i++) {
+            EXPECT_GT(map.Shard(i).Size(), reference.size() / Shards / 2);
+        }
+    }
+
+    ShardedOrderedMapFile<uint64_t, uint64_t, 16, NaturalOrder> map(ShardedMapFileName, Shards, NaturalOrder{});
+    EXPECT_EQ(map.Size(), reference.size());
+    for (uint64_t key = 0; key < 200000; key += 7) {
+        auto found = map.Find(key);
+        auto expected = reference.find(key);
+        ASSERT_EQ(found.HasValue(), expected != reference.end()) << key;
+        if (found) {
+            EXPECT_EQ(*found->value, expected->second);
+        }
+    }
+
+    EXPECT_FALSE(map.Insert(first[0].first, 1));
+    EXPECT_TRUE(map.Erase(first[0].first));
+    EXPECT_FALSE(map.Contains(first[0].first));
+    EXPECT_TRUE(map.InsertOrAssign(first[0].first, 1));
+}
+
+TEST_F(ShardedOrderedMapFileTest, HashPartitionedFixedWidthKeys) {
+    // Padded fixed-width strings have no std::hash; the default partitioner
+    // hashes their bytes
+    struct UrlKey {
+        char url[64];
+    };
+    struct UrlCompare {
+        int operator()(const UrlKey& a, const UrlKey& b) const { return std::strncmp(a.url, b.url, sizeof(a.url)); }
+    };
+    auto make_key = [](size_t i) {
+        UrlKey key{};
+        std::snprintf(key.url, sizeof(key.url), "https://example.com/page/%zu", i);
+        return key;
+    };
+
+    ShardedOrderedMapFile<UrlKey, uint32_t, 16, UrlCompare> map(ShardedMapFileName, Shards, UrlCompare{});
+    for (size_t i = 0; i < 4000; i++) {
+        EXPECT_TRUE(map.Insert(make_key(i), static_cast<uint32_t>(i)));
+    }
+    for (size_t i = 0; i < Shards; i++) {
+        EXPECT_GT(map.Shard(i).Size(), 4000 / Shards / 2);
+    }
+    for (size_t i = 0; i < 4000; i++) {
+        auto found = map.Find(make_key(i));
+        ASSERT_TRUE(found.HasValue()) << i;
+        EXPECT_EQ(*found->value, i);
+    }
+    EXPECT_FALSE(map.Contains(make_key(4000)));
+}
+
+TEST_F(ShardedOrderedMapFileTest, RangePartitionedIteratesInOrder) {
+    using Partitioner = RangePartitioner<uint64_t, NaturalOrder>;
+    Partitioner partitioner(core::Vector<uint64_t>{50000, 100000, 150000}, NaturalOrder{});
+    ShardedOrderedMapFile<uint64_t, uint64_t, 16, NaturalOrder, Partitioner> map(
+        ShardedMapFileName, NaturalOrder{}, partitioner);
+    ASSERT_EQ(map.ShardCount(), Shards);
+    EXPECT_TRUE(map.begin() == map.end());
+
+    std::map<uint64_t, uint64_t> reference;
+    auto pairs = RandomPairs(40000, 3);
+    for (const auto& [key, value] : pairs) {
+        reference.emplace(key, value);
+    }
+    map.InsertParallel(pairs.begin(), pairs.end());
+    EXPECT_EQ(map.ShardOf(49999), 0);
+    EXPECT_EQ(map.ShardOf(50000), 1);
+    EXPECT_EQ(map.ShardOf(199999), 3);
+
+    auto it = reference.begin();
+    for (auto pair : map) {
+        ASSERT_NE(it, reference.end());
+        EXPECT_EQ(*pair.key, it->first);
+        EXPECT_EQ(*pair.value, it->second);
+        ++it;
+    }
+    EXPECT_EQ(it, reference.end());
+
+    EXPECT_THROW(Partitioner(core::Vector<uint64_t>{2, 1}, NaturalOrder{}), std::invalid_argument);
+}
+
+TEST_F(ShardedOrderedMapFileTest, PartitioningIsVerifiedOnReopen) {
+    using HashMap = ShardedOrderedMapFile<uint64_t, uint64_t, 16, NaturalOrder>;
+    using Partitioner = RangePartitioner<uint64_t, NaturalOrder>;
+    using RangeMap = ShardedOrderedMapFile<uint64_t, uint64_t, 16, NaturalOrder, Partitioner>;
+    Partitioner partitioner(core::Vector<uint64_t>{10, 20, 30}, NaturalOrder{});
+    {
+        HashMap map(ShardedMapFileName, Shards, NaturalOrder{});
+        map.Insert(7, 70);
+    }
+    EXPECT_THROW(HashMap(ShardedMapFileName, Shards - 1, NaturalOrder{}), std::runtime_error);
+    EXPECT_THROW(RangeMap(ShardedMapFileName, NaturalOrder{}, partitioner), std::runtime_error);
+    {
+        HashMap map(ShardedMapFileName, Shards, NaturalOrder{});
+        EXPECT_EQ(*map.Find(7)->value, 70);
+    }
+
+    RemoveShards();
+    {
+        RangeMap map(ShardedMapFileName, NaturalOrder{}, partitioner);
+        map.Insert(25, 250);
+    }
+    Partitioner moved(core::Vector<uint64_t>{10, 25, 30}, NaturalOrder{});
+    EXPECT_THROW(RangeMap(ShardedMapFileName, NaturalOrder{}, moved), std::runtime_error);
+    EXPECT_THROW(HashMap(ShardedMapFileName, Shards, NaturalOrder{}), std::runtime_error);
+
+    RangeMap map(ShardedMapFileName, NaturalOrder{}, partitioner);
+    EXPECT_EQ(*map.Find(25)->value, 250);
+}
@@ -1,7 +1,13 @@
+#include "core/read_only_file.h"
+#include "core/thread.h"
 #include "core/vector_file.h"
+#include "core/vector_file_writer.h"
 
+#include <atomic>
 #include <filesystem>
+#include <type_traits>
 #include <gtest/gtest.h>
+#include <vector>
 
 using namespace core;
 
@@ -83,6 +89,23 @@ TEST_F(VectorFileTest, PopBack) {
     EXPECT_TRUE(list.Empty());
 }
 
+TEST_F(VectorFileTest, Clear) {
+    {
+        VectorFile<int> list(VectorFileName, VectorFileOptions{.durability = Durability::Explicit});
+        for (int i = 0; i < 100000; i++) {
+            list.PushBack(i);
+        }
+        list.Clear();
+        EXPECT_TRUE(list.Empty());
+        EXPECT_LE(list.Capacity(), 2 * VectorFile<int>::InitialCapacity);
+        list.PushBack(7);
+    }
+
+    VectorFile<int> list(VectorFileName);
+    ASSERT_EQ(list.Size(), 1);
+    EXPECT_EQ(list[0], 7);
+}
+
 TEST_F(VectorFileTest, Persistence) {
     // Write some data
     {
@@ -261,3 +284,530 @@ TEST_F(VectorFileTest, FixedSizeRecordPersistence) {
         EXPECT_STREQ(list[1].name, "Persistent Two");
     }
 }
+
+TEST_F(VectorFileTest, StableAddressGrowth) {
+    VectorFile<int> list(VectorFileName, VectorFileOptions{.reserveBytes = 64 * 1024 * 1024});
+    ASSERT_TRUE(list.StableAddress());
+
+    list.PushBack(0);
+    int* first = &list[0];
+
+    // Force several rounds of growth
+    for (int i = 1; i < 8 * VectorFile<int>::EntriesPerPage; i++) {
+        list.PushBack(i);
+    }
+
+    EXPECT_EQ(&list[0], first);
+    EXPECT_EQ(list.begin(), first);
+    for (int i = 0; i < list.Size(); i++) {
+        EXPECT_EQ(first[i], i);
+    }
+}
+
+TEST_F(VectorFileTest, StableAddressShrinkAndPersistence) {
+    {
+        VectorFile<int> list(VectorFileName, VectorFileOptions{.reserveBytes = 64 * 1024 * 1024});
+        for (int i = 0; i < 5 * VectorFile<int>::EntriesPerPage; i++) {
+            list.PushBack(i);
+        }
+        size_t peak_capacity = list.Capacity();
+        const int* first = list.Data();
+        while (list.Size() > 10) {
+            list.PopBack();
+        }
+        EXPECT_LT(list.Capacity(), peak_capacity);
+        EXPECT_EQ(list.Data(), first);
+    }
+
+    {
+        VectorFile<int> list(VectorFileName, VectorFileOptions{.reserveBytes = 64 * 1024 * 1024});
+        ASSERT_EQ(list.Size(), 10);
+        int expected = 0;
+        for (int value : list) {
+            EXPECT_EQ(value, expected++);
+        }
+    }
+}
+
+TEST_F(VectorFileTest, StableAddressReservationExhausted) {
+    VectorFile<int> list(VectorFileName, VectorFileOptions{.reserveBytes = 2 * PageSize});
+    EXPECT_THROW(
+        {
+            for (int i = 0; i < 4 * VectorFile<int>::EntriesPerPage; i++) {
+                list.PushBack(i);
+            }
+        },
+        std::length_error);
+}
+
+TEST_F(VectorFileTest, AppendSpan) {
+    VectorFile<int> list(VectorFileName);
+    list.PushBack(-1);
+
+    std::vector<int> values(3 * VectorFile<int>::EntriesPerPage);
+    for (int i = 0; i < values.size(); i++) {
+        values[i] = i;
+    }
+    list.Append(core::Span<const int>{values.data(), values.size()});
+
+    ASSERT_EQ(list.Size(), values.size() + 1);
+    EXPECT_GE(list.Capacity(), list.Size());
+    EXPECT_EQ(list[0], -1);
+    for (int i = 0; i < values.size(); i++) {
+        EXPECT_EQ(list[i + 1], i);
+    }
+}
+
+TEST_F(VectorFileTest, AppendN) {
+    {
+        VectorFile<long> list(VectorFileName);
+        list.PushBack(7);
+        list.AppendN(10000, [](size_t i) { return static_cast<long>(i * 2); });
+        list.AppendN(0, [](size_t) { return 0L; });
+        ASSERT_EQ(list.Size(), 10001);
+    }
+
+    {
+        VectorFile<long> list(VectorFileName);
+        ASSERT_EQ(list.Size(), 10001);
+        EXPECT_EQ(list[0], 7);
+        for (size_t i = 1; i < list.Size(); i++) {
+            EXPECT_EQ(list[i], i * 2);
+        }
+    }
+}
+
+TEST_F(VectorFileTest, PreallocateAndFallocateGrowth) {
+    VectorFile<int> list(VectorFileName, VectorFileOptions{.fallocate = true});
+    list.Preallocate(100000);
+    EXPECT_GE(list.Capacity(), 100000);
+    EXPECT_EQ(list.Size(), 0);
+
+    for (int i = 0; i < 200000; i++) {
+        list.PushBack(i);
+    }
+    EXPECT_EQ(list[199999], 199999);
+    EXPECT_GE(std::filesystem::file_size(VectorFileName), 200000 * sizeof(int));
+}
+
+TEST_F(VectorFileTest, ReadOnlyOpen) {
+    {
+        VectorFile<int> list(VectorFileName);
+        list.PushBack(1);
+        list.PushBack(2);
+    }
+    auto size_before = std::filesystem::file_size(VectorFileName);
+
+    {
+        ReadOnlyFile<VectorFile<int>> list(VectorFileName, VectorFileOptions{.access = AccessHint::Random});
+        EXPECT_TRUE(list->ReadOnly());
+        ASSERT_EQ(list->Size(), 2);
+        EXPECT_EQ((*list)[0], 1);
+        EXPECT_EQ((*list)[1], 2);
+        EXPECT_EQ(list->Data()[1], 2);
+        // Writing through the handle does not compile
+        static_assert(std::is_const_v<std::remove_reference_t<decltype(*list)>>);
+    }
+
+    {
+        // Opened with the bare option, size-changing operations still throw
+        VectorFile<int> list(VectorFileName, VectorFileOptions{.readOnly = true});
+        EXPECT_THROW(list.PushBack(3), std::runtime_error);
+        EXPECT_THROW(list.PopBack(), std::runtime_error);
+        EXPECT_THROW(list.Reserve(1000000), std::runtime_error);
+        EXPECT_EQ(list.Size(), 2);
+    }
+
+    EXPECT_EQ(std::filesystem::file_size(VectorFileName), size_before);
+}
+
+TEST_F(VectorFileTest, ReadOnlyMissingFile) {
+    EXPECT_THROW(VectorFile<int>(VectorFileName, VectorFileOptions{.readOnly = true}), std::runtime_error);
+    EXPECT_FALSE(std::filesystem::exists(VectorFileName));
+}
+
+TEST_F(VectorFileTest, ExplicitCommitPublishesSize) {
+    constexpr const char* SnapshotName = "vector_file_snapshot.dat";
+    {
+        VectorFile<int> list(VectorFileName, VectorFileOptions{.durability = Durability::Explicit});
+        for (int i = 0; i < 10; i++) {
+            list.PushBack(i);
+        }
+        EXPECT_EQ(list.CommittedSize(), 0);
+        EXPECT_EQ(list.Commit(), 10);
+
+        list.PushBack(10);
+        list.PushBack(11);
+        EXPECT_EQ(list.Size(), 12);
+        EXPECT_EQ(list.CommittedSize(), 10);
+
+        // Copy the file as a crash would leave it: only committed appends are published
+        std::filesystem::copy_file(
+            VectorFileName, SnapshotName, std::filesystem::copy_options::overwrite_existing);
+    }
+
+    {
+        VectorFile<int> crashed(SnapshotName);
+        EXPECT_FALSE(crashed.RecoveredTornTail());
+        ASSERT_EQ(crashed.Size(), 10);
+        EXPECT_EQ(crashed[9], 9);
+    }
+    std::filesystem::remove(SnapshotName);
+
+    // Closing commits outstanding appends
+    VectorFile<int> list(VectorFileName, VectorFileOptions{.durability = Durability::Explicit});
+    EXPECT_EQ(list.Size(), 12);
+}
+
+TEST_F(VectorFileTest, SyncCommitsInPlaceWrites) {
+    VectorFile<int> list(VectorFileName, VectorFileOptions{.durability = Durability::Explicit});
+    for (int i = 0; i < 10; i++) {
+        list.PushBack(i);
+    }
+    list.Commit();
+    list[3] = 30;
+    list.PushBack(10);
+
+    list.Sync();
+    EXPECT_EQ(list.CommittedSize(), 11);
+    EXPECT_EQ(list[3], 30);
+
+    ReadOnlyFile<VectorFile<int>> reader(VectorFileName);
+    ASSERT_EQ(reader->Size(), 11);
+    EXPECT_EQ((*reader)[3], 30);
+}
+
+TEST_F(VectorFileTest, PeriodicCommit) {
+    VectorFile<int> list(VectorFileName, VectorFileOptions{.durability = Durability::Periodic, .commitInterval = 100});
+    for (int i = 0; i < 250; i++) {
+        list.PushBack(i);
+    }
+    EXPECT_EQ(list.CommittedSize(), 200);
+
+    std::vector<int> values(100, 1);
+    list.Append(core::Span<const int>{values.data(), values.size()});
+    EXPECT_EQ(list.CommittedSize(), 350);
+}
+
+TEST_F(VectorFileTest, TornTailIsTruncated) {
+    using List = VectorFile<int>;
+    {
+        List list(VectorFileName, VectorFileOptions{.durability = Durability::Explicit});
+        for (int i = 0; i < 100; i++) {
+            list.PushBack(i);
+        }
+        list.Commit();
+        for (int i = 100; i < 150; i++) {
+            list.PushBack(i);
+        }
+        list.Commit();
+    }
+
+    // Corrupt an element inside the last committed range
+    {
+        FILE* file = fopen(VectorFileName, "r+b");
+        ASSERT_NE(file, nullptr);
+        int garbage = -1;
+        fseek(file, static_cast<long>(List::HeaderSpace + (120 * sizeof(int))), SEEK_SET);
+        fwrite(&garbage, sizeof(garbage), 1, file);
+        fclose(file);
+    }
+
+    {
+        List list(VectorFileName, VectorFileOptions{.durability = Durability::Explicit});
+        EXPECT_TRUE(list.RecoveredTornTail());
+        ASSERT_EQ(list.Size(), 100);
+        EXPECT_EQ(list[99], 99);
+    }
+
+    // Repair is persistent
+    List list(VectorFileName);
+    EXPECT_FALSE(list.RecoveredTornTail());
+    EXPECT_EQ(list.Size(), 100);
+}
+
+TEST_F(VectorFileTest, RejectsForeignAndOldFormatFiles) {
+    // Header layout used before files carried a magic number
+    {
+        FILE* file = fopen(VectorFileName, "wb");
+        ASSERT_NE(file, nullptr);
+        size_t old_header[4] = {1024, 3, 0, 0};
+        int values[1024] = {1, 2, 3};
+        fwrite(old_header, sizeof(old_header), 1, file);
+        fwrite(values, sizeof(values), 1, file);
+        fclose(file);
+    }
+    EXPECT_THROW(VectorFile<int>{VectorFileName}, std::runtime_error);
+
+    // The rejected file is left untouched
+    EXPECT_EQ(std::filesystem::file_size(VectorFileName), 4 * sizeof(size_t) + 1024 * sizeof(int));
+}
+
+TEST_F(VectorFileTest, RejectsLayoutMismatch) {
+    {
+        VectorFile<int> list(VectorFileName, VectorFileOptions{.layoutVersion = 2});
+        list.PushBack(7);
+    }
+    EXPECT_THROW(VectorFile<long>{VectorFileName}, std::runtime_error);
+    EXPECT_THROW((CustomVectorFile<int, int>{VectorFileName}), std::runtime_error);
+    EXPECT_THROW(VectorFile<int>{VectorFileName}, std::runtime_error);
+
+    VectorFile<int> list(VectorFileName, VectorFileOptions{.layoutVersion = 2});
+    ASSERT_EQ(list.Size(), 1);
+    EXPECT_EQ(list[0], 7);
+}
+
+TEST_F(VectorFileTest, SwitchingDurabilityModes) {
+    {
+        VectorFile<int> list(VectorFileName, VectorFileOptions{.durability = Durability::Explicit});
+        list.PushBack(1);
+        list.Commit();
+    }
+    {
+        VectorFile<int> list(VectorFileName);
+        list.PushBack(2);
+        list.PushBack(3);
+    }
+    {
+        VectorFile<int> list(VectorFileName, VectorFileOptions{.durability = Durability::Periodic});
+        EXPECT_FALSE(list.RecoveredTornTail());
+        EXPECT_EQ(list.Size(), 3);
+    }
+}
+
+TEST_F(VectorFileTest, HugePageLayout) {
+    using List = VectorFile<int>;
+    for (size_t reserve : {size_t{0}, size_t{64} * 1024 * 1024}) {
+        std::filesystem::remove(VectorFileName);
+        List list(VectorFileName, VectorFileOptions{.reserveBytes = reserve, .hugePages = true});
+
+        auto base = reinterpret_cast<uintptr_t>(list.Data()) - List::HeaderSpace;
+        EXPECT_EQ(base % HugePageSize, 0);
+        EXPECT_EQ(std::filesystem::file_size(VectorFileName) % HugePageSize, 0);
+
+        size_t initial_capacity = list.Capacity();
+        for (int i = 0; i < initial_capacity + 1; i++) {
+            list.PushBack(i);
+        }
+        EXPECT_EQ(std::filesystem::file_size(VectorFileName) % HugePageSize, 0);
+        EXPECT_EQ(list[initial_capacity], initial_capacity);
+        EXPECT_LE(list.HugePageBytes(), std::filesystem::file_size(VectorFileName));
+    }
+}
+
+TEST_F(VectorFileTest, ConcurrentAppend) {
+    constexpr int Threads = 8;
+    constexpr int PerThread = 20000;
+
+    VectorFile<uint64_t> list(VectorFileName, VectorFileOptions{.reserveBytes = 64 * 1024 * 1024});
+    std::atomic<bool> done{false};
+    std::atomic<bool> saw_unwritten{false};
+
+    // Reader checks that every published element is fully written
+    core::Thread reader([&] {
+        while (!done.load()) {
+            size_t published = list.Size();
+            for (size_t i = 0; i < published; i += 97) {
+                if (list.Data()[i] == 0) {
+                    saw_unwritten = true;
+                }
+            }
+        }
+    });
+
+    std::vector<core::Thread> writers;
+    for (int t = 0; t < Threads; t++) {
+        writers.emplace_back([&list, t] {
+            for (uint64_t i = 0; i < PerThread; i++) {
+                if (i % 10 == 0) {
+                    uint64_t batch[3] = {t * 1000000ULL + i + 1, 0, 0};
+                    list.ConcurrentAppend(core::Span<const uint64_t>{batch, 1});
+                } else {
+                    list.ConcurrentPushBack(t * 1000000ULL + i + 1);
+                }
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.Join();
+    }
+    done = true;
+    reader.Join();
+
+    EXPECT_FALSE(saw_unwritten);
+    ASSERT_EQ(list.Size(), Threads * PerThread);
+
+    // Each thread's values appear exactly once, in the order it appended them
+    std::vector<uint64_t> next(Threads, 1);
+    for (uint64_t value : list) {
+        uint64_t t = value / 1000000;
+        ASSERT_LT(t, Threads);
+        EXPECT_EQ(value % 1000000, next[t]);
+        next[t] = value % 1000000 + 1;
+    }
+    for (int t = 0; t < Threads; t++) {
+        EXPECT_EQ(next[t], PerThread + 1);
+    }
+}
+
+TEST_F(VectorFileTest, ConcurrentAppendRequiresStableAddress) {
+    VectorFile<int> list(VectorFileName);
+    EXPECT_THROW(list.ConcurrentPushBack(1), std::runtime_error);
+    EXPECT_EQ(list.Size(), 0);
+}
+
+TEST_F(VectorFileTest, SnapshotIsStableAcrossRemaps) {
+    VectorFile<uint64_t> list(VectorFileName);
+    for (uint64_t i = 0; i < 100; i++) {
+        list.PushBack(i);
+    }
+
+    auto snapshot = list.TakeSnapshot();
+    ASSERT_EQ(snapshot.Size(), 100);
+
+    // Growth moves the file's mapping, but the snapshot keeps the old one
+    for (uint64_t i = 100; i < 100000; i++) {
+        list.PushBack(i);
+    }
+    EXPECT_EQ(snapshot.Size(), 100);
+    for (uint64_t i = 0; i < snapshot.Size(); i++) {
+        EXPECT_EQ(snapshot[i], i);
+    }
+    EXPECT_THROW(snapshot[100], std::out_of_range);
+    EXPECT_EQ(list.TakeSnapshot().Size(), 100000);
+}
+
+TEST_F(VectorFileTest, SnapshotsDuringConcurrentIngest) {
+    constexpr uint64_t Count = 200000;
+
+    VectorFile<uint64_t> list(VectorFileName);
+    std::atomic<bool> done{false};
+    std::atomic<bool> saw_mismatch{false};
+
+    std::vector<core::Thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&] {
+            size_t last_size = 0;
+            while (!done.load()) {
+                auto snapshot = list.TakeSnapshot();
+                if (snapshot.Size() < last_size) {
+                    saw_mismatch = true;
+                }
+                last_size = snapshot.Size();
+                for (size_t i = 0; i < snapshot.Size(); i += 61) {
+                    if (snapshot[i] != i) {
+                        saw_mismatch = true;
+                    }
+                }
+            }
+        });
+    }
+
+    for (uint64_t i = 0; i < Count; i++) {
+        list.PushBack(i);
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.Join();
+    }
+
+    EXPECT_FALSE(saw_mismatch);
+}
+
+TEST_F(VectorFileTest, SnapshotOutlivesFileAndBlocksShrink) {
+    VectorFile<int>::Snapshot snapshot;
+    {
+        VectorFile<int> list(VectorFileName, VectorFileOptions{.reserveBytes = 16 * 1024 * 1024});
+        for (int i = 0; i < 10000; i++) {
+            list.PushBack(i);
+        }
+        snapshot = list.TakeSnapshot();
+
+        size_t capacity = list.Capacity();
+        while (!list.Empty()) {
+            list.PopBack();
+        }
+        EXPECT_EQ(list.Capacity(), capacity);
+    }
+
+    ASSERT_EQ(snapshot.Size(), 10000);
+    EXPECT_EQ(snapshot[9999], 9999);
+}
+
+TEST_F(VectorFileTest, WriterOutputOpensAsVectorFile) {
+    struct Meta {
+        uint64_t magic;
+    };
+
+    constexpr size_t Count = 300000;
+    {
+        CustomVectorFileWriter<TrivialStruct, Meta> writer(VectorFileName, VectorFileWriterOptions{.bufferBytes = 64 * 1024});
+        writer.CustomData()->magic = 0xABCD;
+        for (size_t i = 0; i < Count; i++) {
+            if (i % 7 == 0) {
+                TrivialStruct batch[2] = {{static_cast<int>(i), i * 0.5, 'a'}, {static_cast<int>(i + 1), (i + 1) * 0.5, 'a'}};
+                if (i + 1 < Count) {
+                    writer.Append(core::Span<const TrivialStruct>{batch, 2});
+                    i++;
+                    continue;
+                }
+            }
+            writer.PushBack(TrivialStruct{static_cast<int>(i), i * 0.5, 'a'});
+        }
+        EXPECT_EQ(writer.Size(), Count);
+        writer.Close();
+        EXPECT_THROW(writer.PushBack(TrivialStruct{}), std::runtime_error);
+    }
+
+    CustomVectorFile<TrivialStruct, Meta> list(VectorFileName);
+    EXPECT_FALSE(list.RecoveredTornTail());
+    EXPECT_EQ(list.CustomData()->magic, 0xABCD);
+    ASSERT_EQ(list.Size(), Count);
+    for (size_t i = 0; i < Count; i++) {
+        ASSERT_EQ(list[i].x, static_cast<int>(i));
+        ASSERT_EQ(list[i].y, i * 0.5);
+    }
+
+    // File continues to grow through the mapped path
+    list.PushBack(TrivialStruct{-1, 0, 'b'});
+    EXPECT_EQ(list.Back().x, -1);
+}
+
+TEST_F(VectorFileTest, WriterDirectIOAndEmpty) {
+    {
+        VectorFileWriter<int> writer(VectorFileName, VectorFileWriterOptions{.directIO = true});
+        for (int i = 0; i < 5000; i++) {
+            writer.PushBack(i);
+        }
+        writer.Close();
+    }
+    {
+        VectorFile<int> list(VectorFileName);
+        ASSERT_EQ(list.Size(), 5000);
+        EXPECT_EQ(list[4999], 4999);
+    }
+
+    {
+        VectorFileWriter<int> writer(VectorFileName);
+        writer.Close();
+    }
+    VectorFile<int> list(VectorFileName);
+    EXPECT_TRUE(list.Empty());
+    list.PushBack(7);
+    EXPECT_EQ(list[0], 7);
+}
+
+TEST_F(VectorFileTest, AbandonedWriterLeavesInvalidFile) {
+    // Abandoned after the buffer has been flushed at least once
+    {
+        VectorFileWriter<int> writer(VectorFileName, VectorFileWriterOptions{.bufferBytes = 4096});
+        for (int i = 0; i < 5000; i++) {
+            writer.PushBack(i);
+        }
+    }
+    EXPECT_THROW(VectorFile<int>{VectorFileName}, std::runtime_error);
+
+    // Abandoned before anything was written
+    { VectorFileWriter<int> writer(VectorFileName); }
+    EXPECT_THROW(VectorFile<int>{VectorFileName}, std::runtime_error);
+}
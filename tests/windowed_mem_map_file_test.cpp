@@ -0,0 +1,78 @@
+#include "core/windowed_mem_map_file.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+
+using core::WindowedMemMapFile;
+using core::WindowedMemMapFileOptions;
+
+namespace {
+
+struct Record {
+    uint64_t id;
+    uint32_t payload[5];
+};
+
+class WindowedMemMapFileTest : public ::testing::Test {
+protected:
+    static constexpr size_t RecordCount = 50000;
+
+    fs::path temp_file_path_;
+
+    void SetUp() override {
+        temp_file_path_ = fs::temp_directory_path() / "windowed_mmap_test_file";
+        std::vector<Record> records(RecordCount);
+        for (size_t i = 0; i < RecordCount; i++) {
+            records[i].id = i;
+            for (uint32_t j = 0; j < 5; j++) {
+                records[i].payload[j] = static_cast<uint32_t>(i * 5 + j);
+            }
+        }
+        std::ofstream ofs(temp_file_path_, std::ios::binary);
+        ofs.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+    }
+
+    void TearDown() override { fs::remove(temp_file_path_); }
+};
+
+}  // namespace
+
+TEST_F(WindowedMemMapFileTest, RecordsAcrossWindows) {
+    // Windows of one page, so records straddle window starts
+    WindowedMemMapFile file(temp_file_path_.string(),
+                            WindowedMemMapFileOptions{.windowSize = 4096, .windowOverlap = 4096, .maxWindows = 3});
+    ASSERT_EQ(file.size(), RecordCount * sizeof(Record));
+
+    for (size_t i = 0; i < RecordCount; i += 17) {
+        const Record& record = file.Record<Record>(i);
+        ASSERT_EQ(record.id, i);
+        EXPECT_EQ(record.payload[4], i * 5 + 4);
+        EXPECT_LE(file.MappedWindows(), 3);
+    }
+
+    std::vector<Record> out(1000);
+    file.ReadRecords(RecordCount - 1000, core::Span<Record>{out.data(), out.size()});
+    for (size_t i = 0; i < out.size(); i++) {
+        EXPECT_EQ(out[i].id, RecordCount - 1000 + i);
+    }
+    EXPECT_LE(file.MappedWindows(), 3);
+}
+
+TEST_F(WindowedMemMapFileTest, Bounds) {
+    WindowedMemMapFile file(temp_file_path_.string(), WindowedMemMapFileOptions{.windowSize = 65536});
+
+    EXPECT_EQ(file.View(file.size(), 0).Size(), 0);
+    EXPECT_THROW(file.View(file.size() - 4, 8), std::out_of_range);
+    EXPECT_THROW(file.Record<Record>(RecordCount), std::out_of_range);
+    EXPECT_THROW(file.View(0, 1024 * 1024), std::length_error);
+
+    char last = 0;
+    file.Read(file.size() - 1, &last, 1);
+    EXPECT_EQ(last, 0);
+    EXPECT_THROW(WindowedMemMapFile("/nonexistent/windowed"), core::FileOpenFailure);
+}
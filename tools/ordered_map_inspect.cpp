@@ -0,0 +1,133 @@
+/**
+ * @file ordered_map_inspect.cpp
+ * @brief Reports the structure of an OrderedMapFile: depth, node counts, fill,
+ * byte split between internal nodes and leaves, key distribution, and
+ * per-level residency in the page cache.
+ *
+ * Usage: ordered_map_inspect <path> <key bytes> <value bytes> <N>
+ *
+ * The file is opened read-only. Its layout follows from the key and value
+ * sizes (4 or 8 bytes, as unsigned integers) and the node fanout N, which must
+ * match the map that wrote it.
+ */
+
+#include "core/ordered_map_file.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+
+namespace {
+
+template<typename K, typename V, size_t N>
+void Inspect(const char* path) {
+    using Map = core::OrderedMapFile<K, V, N, core::NaturalOrder>;
+    Map map(path, core::NaturalOrder{}, core::VectorFileOptions{.readOnly = true});
+    auto stats = map.Stats();
+
+    std::printf("keys            %zu\n", stats.size);
+    std::printf("depth           %zu\n", stats.depth);
+    std::printf("nodes           %zu (%zu free)\n", stats.nodeCount, stats.freeNodes);
+    std::printf("node bytes      %zu\n", stats.nodeBytes);
+    std::printf("internal bytes  %zu\n", stats.internalBytes);
+    std::printf("leaf bytes      %zu\n", stats.leafBytes);
+    std::printf("leaf fill       %.3f\n", stats.leafFillFactor);
+
+    std::printf("\nlevel       nodes          keys    fill   resident\n");
+    for (size_t i = 0; i < stats.levels.size(); i++) {
+        const auto& level = stats.levels[i];
+        std::printf("%5zu %11zu %13zu   %.3f   %.3f\n",
+                    i,
+                    level.nodes,
+                    level.keys,
+                    level.fillFactor,
+                    static_cast<double>(level.residentNodes) / static_cast<double>(level.nodes));
+    }
+
+    std::printf("\nleaf fill   leaves\n");
+    for (size_t i = 0; i < stats.leafFillHistogram.Size(); i++) {
+        std::printf("%3zu-%3zu%% %9zu\n", i * 10, (i + 1) * 10, stats.leafFillHistogram[i]);
+    }
+
+    if (!stats.keyDeciles.empty()) {
+        std::printf("\nquantile  key\n");
+        for (size_t i = 0; i < stats.keyDeciles.size(); i++) {
+            std::printf("%7zu%%  %llu\n", i * 10, static_cast<unsigned long long>(stats.keyDeciles[i]));
+        }
+    }
+}
+
+template<typename K, typename V>
+bool InspectFanout(const char* path, size_t n) {
+    switch (n) {
+    case 8:
+        Inspect<K, V, 8>(path);
+        return true;
+    case 16:
+        Inspect<K, V, 16>(path);
+        return true;
+    case 32:
+        Inspect<K, V, 32>(path);
+        return true;
+    case 64:
+        Inspect<K, V, 64>(path);
+        return true;
+    case 128:
+        Inspect<K, V, 128>(path);
+        return true;
+    case 256:
+        Inspect<K, V, 256>(path);
+        return true;
+    default:
+        return false;
+    }
+}
+
+template<typename K>
+bool InspectValue(const char* path, size_t value_bytes, size_t n) {
+    switch (value_bytes) {
+    case 4:
+        return InspectFanout<K, uint32_t>(path, n);
+    case 8:
+        return InspectFanout<K, uint64_t>(path, n);
+    default:
+        return false;
+    }
+}
+
+bool InspectKey(const char* path, size_t key_bytes, size_t value_bytes, size_t n) {
+    switch (key_bytes) {
+    case 4:
+        return InspectValue<uint32_t>(path, value_bytes, n);
+    case 8:
+        return InspectValue<uint64_t>(path, value_bytes, n);
+    default:
+        return false;
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc != 5) {
+        std::fprintf(stderr, "usage: %s <path> <key bytes> <value bytes> <N>\n", argv[0]);
+        return 2;
+    }
+
+    try {
+        size_t key_bytes = std::stoul(argv[2]);
+        size_t value_bytes = std::stoul(argv[3]);
+        size_t n = std::stoul(argv[4]);
+        if (!InspectKey(argv[1], key_bytes, value_bytes, n)) {
+            std::fprintf(stderr,
+                         "unsupported layout: keys and values of 4 or 8 bytes, N a power of two from 8 to 256\n");
+            return 2;
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s: %s\n", argv[1], e.what());
+        return 1;
+    }
+    return 0;
+}